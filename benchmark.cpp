@@ -0,0 +1,45 @@
+#include <iostream>
+#include <string>
+
+#include "limex.h"
+
+#include "generator.h"
+#include "benchmark.h"
+
+
+int main(int argc, char* argv[])
+{
+  // usage: ./benchmark [--counters] [--scaling <depth>] [--seed <seed>] [rows]
+  bool counters = false;
+  size_t scaling = 0;
+  uint64_t seed = 1;
+  size_t rows = 100000;
+  for ( int i = 1; i < argc; i++ ) {
+    std::string argument = argv[i];
+    if ( argument == "--counters" ) {
+      counters = true;
+    }
+    else if ( argument == "--scaling" && i + 1 < argc ) {
+      scaling = std::stoul(argv[++i]);
+    }
+    else if ( argument == "--seed" && i + 1 < argc ) {
+      seed = std::stoull(argv[++i]);
+    }
+    else {
+      rows = std::stoul(argument);
+    }
+  }
+
+  if ( scaling ) {
+    benchmarkScaling(scaling, rows, seed);
+    return 0;
+  }
+
+  benchmark("arithmetic", "3*x + y/2 - z²", rows, counters);
+  benchmark("functions", "sqrt(x² + y²) + pow(z, 0.5) + abs(x - y)", rows, counters);
+  benchmark("conditionals", "(x < 0.5) ? (y > 0.3 ? x : y) : max{x, y, z}", rows, counters);
+  benchmark("sets", "(x ∈ {0.1, 0.2, 0.3, 0.4, 0.5}) ? 1 : (y ∉ {0.25, 0.75}) ? 2 : 3", rows, counters);
+  benchmark("collections", "sum{c[]} * x + c[3] - min{c[]}", rows, counters);
+
+  return 0;
+}
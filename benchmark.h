@@ -0,0 +1,240 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <optional>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Collects hardware and software performance counters of the calling thread.
+ *
+ * Counters are opened individually with `perf_event_open` so that counters not supported by the
+ * processor or not permitted by the kernel are reported as unavailable without affecting the others.
+ */
+class Counters {
+public:
+  struct Event { std::string name; uint32_t type; uint64_t config; int descriptor = -1; };
+  Counters();
+  ~Counters();
+  Counters(const Counters&) = delete;
+  Counters& operator=(const Counters&) = delete;
+  void start();
+  void stop();
+  std::vector< std::pair<std::string, std::optional<uint64_t>> > read() const; /// Counter values since start, if available
+private:
+  std::vector<Event> events;
+};
+
+Counters::Counters() {
+#ifdef __linux__
+  auto cache = [](uint64_t cache, uint64_t result) {
+    return cache | ( (uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( result << 16 );
+  };
+  events = {
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "L1d-misses", PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { "LLC-misses", PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { "page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS }
+  };
+  for ( auto& event : events ) {
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = event.type;
+    attributes.config = event.config;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    event.descriptor = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+  }
+#endif
+}
+
+Counters::~Counters() {
+#ifdef __linux__
+  for ( auto& event : events ) {
+    if ( event.descriptor >= 0 ) close(event.descriptor);
+  }
+#endif
+}
+
+void Counters::start() {
+#ifdef __linux__
+  for ( auto& event : events ) {
+    if ( event.descriptor < 0 ) continue;
+    ioctl(event.descriptor, PERF_EVENT_IOC_RESET, 0);
+    ioctl(event.descriptor, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+void Counters::stop() {
+#ifdef __linux__
+  for ( auto& event : events ) {
+    if ( event.descriptor >= 0 ) ioctl(event.descriptor, PERF_EVENT_IOC_DISABLE, 0);
+  }
+#endif
+}
+
+std::vector< std::pair<std::string, std::optional<uint64_t>> > Counters::read() const {
+  std::vector< std::pair<std::string, std::optional<uint64_t>> > values;
+#ifdef __linux__
+  for ( auto& event : events ) {
+    uint64_t value;
+    if ( event.descriptor >= 0 && ::read(event.descriptor, &value, sizeof(value)) == sizeof(value) ) {
+      values.emplace_back(event.name, value);
+    }
+    else {
+      values.emplace_back(event.name, std::nullopt);
+    }
+  }
+#endif
+  return values;
+}
+
+size_t countNodes( const LIMEX::Node<double>& node ) {
+  size_t count = 1;
+  for ( auto& operand : node.operands ) {
+    if ( std::holds_alternative< LIMEX::Node<double> >(operand) ) {
+      count += countNodes( std::get< LIMEX::Node<double> >(operand) );
+    }
+  }
+  return count;
+}
+
+/**
+ * Evaluates the expression for the given number of rows, once row by row and once as a batch, and
+ * reports the time and, if requested, the performance counters per row and per evaluated node.
+ */
+void benchmark( std::string name, std::string input, size_t rows, bool withCounters ) {
+  LIMEX::Handle<double> handle;
+  LIMEX::Expression<double> expression(input,handle);
+  size_t nodes = countNodes(expression.getRoot());
+
+  // deterministic values in (0,1] for all variables and collections
+  std::vector< std::vector<double> > columns(expression.getVariables().size(), std::vector<double>(rows));
+  for ( size_t i = 0; i < columns.size(); i++ ) {
+    for ( size_t row = 0; row < rows; row++ ) {
+      columns[i][row] = (double)( ( row * 7919 + i * 104729 ) % 1000 + 1 ) / 1000;
+    }
+  }
+  std::vector< std::vector<double> > collections(expression.getCollections().size(), std::vector<double>(16));
+  for ( size_t i = 0; i < collections.size(); i++ ) {
+    for ( size_t j = 0; j < collections[i].size(); j++ ) {
+      collections[i][j] = (double)( j + i + 1 ) / 16;
+    }
+  }
+
+  auto report = [&](const std::string& mode, std::chrono::nanoseconds duration, Counters* counters, double checksum) {
+    double perRow = (double)duration.count() / rows;
+    std::cout << std::left << std::setw(24) << name << std::setw(8) << mode
+              << " rows: " << rows << ", nodes: " << nodes
+              << ", ns/row: " << std::fixed << std::setprecision(2) << perRow
+              << ", ns/node: " << perRow / nodes
+              << ", checksum: " << std::defaultfloat << checksum << std::endl;
+    if ( !counters ) return;
+    for ( auto& [counter, value] : counters->read() ) {
+      std::cout << "  " << std::setw(16) << counter;
+      if ( value.has_value() ) {
+        std::cout << std::fixed << std::setprecision(3)
+                  << " per row: " << (double)value.value() / rows
+                  << ", per node: " << (double)value.value() / rows / nodes << std::defaultfloat << std::endl;
+      }
+      else {
+        std::cout << " unavailable" << std::endl;
+      }
+    }
+  };
+
+  std::optional<Counters> counters;
+  if ( withCounters ) {
+    counters.emplace();
+  }
+
+  // row by row
+  double checksum = 0;
+  std::vector<double> values(columns.size());
+  if ( counters ) counters->start();
+  auto start = std::chrono::steady_clock::now();
+  for ( size_t row = 0; row < rows; row++ ) {
+    for ( size_t i = 0; i < columns.size(); i++ ) {
+      values[i] = columns[i][row];
+    }
+    checksum += expression.evaluate(values,collections);
+  }
+  auto duration = std::chrono::steady_clock::now() - start;
+  if ( counters ) counters->stop();
+  report("scalar", duration, counters ? &counters.value() : nullptr, checksum);
+
+  // batch
+  if ( counters ) counters->start();
+  start = std::chrono::steady_clock::now();
+  auto results = expression.evaluateBatch(columns,collections);
+  duration = std::chrono::steady_clock::now() - start;
+  if ( counters ) counters->stop();
+  checksum = 0;
+  for ( auto result : results ) {
+    checksum += result;
+  }
+  report("batch", duration, counters ? &counters.value() : nullptr, checksum);
+}
+
+/**
+ * Parses and evaluates generated expressions of increasing depth and reports the time per node
+ * for parsing and per node and row for evaluation.
+ */
+void benchmarkScaling( size_t maxDepth, size_t rows, uint64_t seed, size_t count = 16 ) {
+  LIMEX::Handle<double> handle;
+  for ( size_t depth = 1; depth <= maxDepth; depth++ ) {
+    Generator generator(Generator::Shape{ .depth = depth }, seed);
+    std::vector<std::string> inputs;
+    for ( size_t i = 0; i < count; i++ ) {
+      inputs.push_back( generator.expression() );
+    }
+
+    size_t nodes = 0;
+    std::chrono::nanoseconds parsing{0}, scalar{0}, batch{0};
+    double checksum = 0;
+    for ( auto& input : inputs ) {
+      auto start = std::chrono::steady_clock::now();
+      LIMEX::Expression<double> expression(input,handle);
+      parsing += std::chrono::steady_clock::now() - start;
+      nodes += countNodes(expression.getRoot());
+
+      auto collections = generator.collectionValues(expression.getCollections().size());
+      std::vector< std::vector<double> > rowValues;
+      std::vector< std::vector<double> > columns(expression.getVariables().size(), std::vector<double>(rows));
+      for ( size_t row = 0; row < rows; row++ ) {
+        rowValues.push_back( generator.variableValues(expression.getVariables().size()) );
+        for ( size_t i = 0; i < columns.size(); i++ ) {
+          columns[i][row] = rowValues.back()[i];
+        }
+      }
+
+      start = std::chrono::steady_clock::now();
+      for ( auto& values : rowValues ) {
+        checksum += expression.evaluate(values,collections);
+      }
+      scalar += std::chrono::steady_clock::now() - start;
+
+      start = std::chrono::steady_clock::now();
+      auto results = expression.evaluateBatch(columns,collections);
+      batch += std::chrono::steady_clock::now() - start;
+    }
+    std::cout << "depth: " << std::setw(2) << depth 
+              << std::fixed << std::setprecision(2)
+              << ", nodes per expression: " << std::setw(8) << (double)nodes / count
+              << ", parse ns/node: " << (double)parsing.count() / nodes
+              << ", scalar ns/node/row: " << (double)scalar.count() / nodes / rows
+              << ", batch ns/node/row: " << (double)batch.count() / nodes / rows 
+              << std::defaultfloat << ", checksum: " << checksum << std::endl;
+  }
+}
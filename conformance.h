@@ -0,0 +1,333 @@
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <charconv>
+#include <algorithm>
+
+/**
+ * @brief Checks that all evaluation engines agree with the reference evaluation of expressions.
+ *
+ * Each check parses the input, evaluates it with `Node::evaluate` as reference, and evaluates it with
+ * every registered engine for the same variable and collection values. Results must be identical or,
+ * for engines with a tolerance, deviate by at most the given relative tolerance. An engine must throw
+ * if and only if the reference evaluation throws. For each disagreement, the expression is greedily
+ * reduced by replacing operations with one of their operands or with a literal for as long as the
+ * engine still disagrees, giving a minimized reproducer.
+ */
+class Conformance {
+public:
+  using Variables = std::map<std::string, double>;
+  using Collections = std::map<std::string, std::vector<double>>;
+  struct Engine {
+    std::string name;
+    double tolerance = 0; /// Maximum relative deviation from the reference result
+    std::function<double(const LIMEX::Handle<double>& handle, const std::string& input, const Variables& variables, const Collections& collections)> evaluate;
+  };
+  struct Outcome {
+    std::optional<double> value; /// Result, if the evaluation succeeded
+    std::string error; /// Exception message, if the evaluation failed
+  };
+  struct Mismatch {
+    std::string engine;
+    std::string input;
+    std::string reproducer; /// Minimized expression for which the engine still disagrees
+    Outcome expected;
+    Outcome actual;
+  };
+  Conformance(const LIMEX::Handle<double>& handle, bool builtinEngines = true);
+  void add(Engine engine) { engines.push_back(std::move(engine)); }
+  const std::vector<Engine>& getEngines() const { return engines; }
+  std::vector<Mismatch> check(const std::string& input, const Variables& variables, const Collections& collections = {}) const;
+  // Provide values by name in the order used by the expression, collections up to the first missing one
+  static std::pair< std::vector<double>, std::vector<std::vector<double>> > arguments(const LIMEX::Expression<double>& expression, const Variables& variables, const Collections& collections);
+  static std::string describe(const Outcome& outcome);
+private:
+  const LIMEX::Handle<double>& handle;
+  std::vector<Engine> engines;
+  std::shared_ptr<LIMEX::Pool> pool;
+  Outcome reference(const std::string& input, const Variables& variables, const Collections& collections) const;
+  Outcome run(const Engine& engine, const std::string& input, const Variables& variables, const Collections& collections) const;
+  bool agree(const Engine& engine, const Outcome& expected, const Outcome& actual) const;
+  std::string minimize(const Engine& engine, const std::string& input, const Variables& variables, const Collections& collections) const;
+};
+
+std::pair< std::vector<double>, std::vector<std::vector<double>> > Conformance::arguments(const LIMEX::Expression<double>& expression, const Variables& variables, const Collections& collections) {
+  std::vector<double> variableValues;
+  for ( auto& name : expression.getVariables() ) {
+    auto it = variables.find(name);
+    if ( it == variables.end() ) {
+      throw std::invalid_argument("LIMEX: No value given for variable '" + name + "'");
+    }
+    variableValues.push_back(it->second);
+  }
+  std::vector<std::vector<double>> collectionValues;
+  for ( auto& name : expression.getCollections() ) {
+    auto it = collections.find(name);
+    if ( it == collections.end() ) {
+      // remaining collections are missing
+      break;
+    }
+    collectionValues.push_back(it->second);
+  }
+  return { std::move(variableValues), std::move(collectionValues) };
+}
+
+std::string Conformance::describe(const Outcome& outcome) {
+  if ( outcome.value.has_value() ) {
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), outcome.value.value());
+    return std::string(digits, result.ptr);
+  }
+  return "exception '" + outcome.error + "'";
+}
+
+Conformance::Conformance(const LIMEX::Handle<double>& handle, bool builtinEngines)
+  : handle(handle)
+  , pool(std::make_shared<LIMEX::Pool>(2))
+{
+  if ( !builtinEngines ) {
+    return;
+  }
+  using LIMEX::Expression;
+  // number of identical rows evaluated by batch engines, all rows must give the same result
+  static constexpr size_t rows = 5;
+  auto batch = [](const std::vector<double>& results) {
+    for ( auto result : results ) {
+      if ( std::memcmp(&result, &results.front(), sizeof(double)) != 0 ) {
+        throw std::logic_error("LIMEX: Rows with identical values have different results");
+      }
+    }
+    return results.front();
+  };
+
+  add({ "evaluate", 0, [](auto& handle, auto& input, auto& variables, auto& collections) {
+    Expression<double> expression(input,handle);
+    auto [variableValues, collectionValues] = arguments(expression,variables,collections);
+    return expression.evaluate(variableValues,collectionValues);
+  }});
+  add({ "lazy", 0, [](auto& handle, auto& input, auto& variables, auto& collections) {
+    Expression<double> expression(input,handle,Expression<double>::PARSING::LAZY);
+    auto [variableValues, collectionValues] = arguments(expression,variables,collections);
+    return expression.evaluate(variableValues,collectionValues);
+  }});
+  add({ "batch", 0, [batch](auto& handle, auto& input, auto& variables, auto& collections) {
+    Expression<double> expression(input,handle);
+    auto [variableValues, collectionValues] = arguments(expression,variables,collections);
+    std::vector<std::vector<double>> columns;
+    for ( auto value : variableValues ) {
+      columns.emplace_back(rows, value);
+    }
+    return batch( expression.evaluateBatch(columns,collectionValues) );
+  }});
+  add({ "pool", 0, [batch, pool = pool](auto& handle, auto& input, auto& variables, auto& collections) {
+    Expression<double> expression(input,handle);
+    auto [variableValues, collectionValues] = arguments(expression,variables,collections);
+    std::vector<std::vector<double>> columns;
+    for ( auto value : variableValues ) {
+      columns.emplace_back(rows, value);
+    }
+    std::vector<double> results(rows);
+    expression.evaluateBatch(*pool,results,columns,collectionValues);
+    return batch(results);
+  }});
+  add({ "async", 0, [](auto& handle, auto& input, auto& variables, auto& collections) {
+    Expression<double> expression(input,handle);
+    auto [variableValues, collectionValues] = arguments(expression,variables,collections);
+    LIMEX::Scheduler<double> scheduler;
+    scheduler.submit(expression,variableValues,collectionValues);
+    scheduler.run();
+    return scheduler.get(0);
+  }});
+  add({ "cached", 0, [](auto& handle, auto& input, auto& variables, auto& collections) {
+    Expression<double> expression(input,handle);
+    auto [variableValues, collectionValues] = arguments(expression,variables,collections);
+    try {
+      expression.enableCache(16);
+    }
+    catch ( const std::logic_error& ) {
+      // impure expressions are not cached
+    }
+    try {
+      // populate the cache
+      expression.evaluate(variableValues,collectionValues);
+    }
+    catch ( const std::runtime_error& ) {
+    }
+    return expression.evaluate(variableValues,collectionValues);
+  }});
+  add({ "specialized", 0, [](auto& handle, auto& input, auto& variables, auto& collections) {
+    Expression<double> expression(input,handle);
+    auto [variableValues, collectionValues] = arguments(expression,variables,collections);
+    expression.enableSpecialization(1);
+    try {
+      // observe all variables as constant
+      expression.evaluate(variableValues,collectionValues);
+    }
+    catch ( const std::runtime_error& ) {
+    }
+    return expression.evaluate(variableValues,collectionValues);
+  }});
+  add({ "canonical", 0, [](auto& handle, auto& input, auto& variables, auto& collections) {
+    // only operands whose order cannot change rounding are reordered
+    Expression<double> expression(input,handle);
+    expression.canonicalize();
+    auto [variableValues, collectionValues] = arguments(expression,variables,collections);
+    return expression.evaluate(variableValues,collectionValues);
+  }});
+  add({ "serialized", 0, [](auto& handle, auto& input, auto& variables, auto& collections) {
+    Expression<double> expression(Expression<double>(input,handle).serialize(),handle);
+    auto [variableValues, collectionValues] = arguments(expression,variables,collections);
+    return expression.evaluate(variableValues,collectionValues);
+  }});
+  add({ "archived", 0, [](auto& handle, auto& input, auto& variables, auto& collections) {
+    LIMEX::Archive<double> archive(handle, 1 << 16);
+    auto expression = archive.get( archive.add(input) );
+    auto [variableValues, collectionValues] = arguments(*expression,variables,collections);
+    return expression->evaluate(variableValues,collectionValues);
+  }});
+  add({ "retargeted", 0, [target = std::make_shared< LIMEX::Handle<double, LIMEX::Collection<double>> >()](auto& handle, auto& input, auto& variables, auto& collections) {
+    // expression and collections are converted to another collection type
+    Expression<double> original(input,handle);
+    Expression<double, LIMEX::Collection<double>> expression(original,*target);
+    auto [variableValues, collectionValues] = arguments(original,variables,collections);
+    std::vector< LIMEX::Collection<double> > converted(collectionValues.begin(), collectionValues.end());
+    return expression.evaluate(variableValues,converted);
+  }});
+}
+
+Conformance::Outcome Conformance::reference(const std::string& input, const Variables& variables, const Collections& collections) const {
+  LIMEX::Expression<double> expression(input,handle);
+  auto [variableValues, collectionValues] = arguments(expression,variables,collections);
+  try {
+    return { expression.getRoot().evaluate(variableValues,collectionValues), {} };
+  }
+  catch ( const std::exception& e ) {
+    return { std::nullopt, e.what() };
+  }
+}
+
+Conformance::Outcome Conformance::run(const Engine& engine, const std::string& input, const Variables& variables, const Collections& collections) const {
+  try {
+    return { engine.evaluate(handle,input,variables,collections), {} };
+  }
+  catch ( const std::exception& e ) {
+    return { std::nullopt, e.what() };
+  }
+}
+
+bool Conformance::agree(const Engine& engine, const Outcome& expected, const Outcome& actual) const {
+  if ( !expected.value.has_value() || !actual.value.has_value() ) {
+    // messages may differ between engines
+    return expected.value.has_value() == actual.value.has_value();
+  }
+  double a = expected.value.value();
+  double b = actual.value.value();
+  if ( std::memcmp(&a, &b, sizeof(double)) == 0 || ( std::isnan(a) && std::isnan(b) ) ) {
+    return true;
+  }
+  return std::abs(a - b) <= engine.tolerance * std::max({ 1.0, std::abs(a), std::abs(b) });
+}
+
+std::vector<Conformance::Mismatch> Conformance::check(const std::string& input, const Variables& variables, const Collections& collections) const {
+  std::vector<Mismatch> mismatches;
+  auto expected = reference(input,variables,collections);
+  for ( auto& engine : engines ) {
+    auto actual = run(engine,input,variables,collections);
+    if ( !agree(engine,expected,actual) ) {
+      mismatches.push_back({ engine.name, input, minimize(engine,input,variables,collections), expected, actual });
+    }
+  }
+  return mismatches;
+}
+
+std::string Conformance::minimize(const Engine& engine, const std::string& input, const Variables& variables, const Collections& collections) const {
+  using Node = LIMEX::Node<double>;
+  using Type = LIMEX::Type;
+  auto mismatch = [&](const std::string& candidate) {
+    try {
+      return !agree(engine, reference(candidate,variables,collections), run(engine,candidate,variables,collections));
+    }
+    catch ( const std::exception& ) {
+      // values are missing for the candidate
+      return false;
+    }
+  };
+
+  std::string reproducer = LIMEX::Expression<double>(input,handle).serialize();
+  if ( !mismatch(reproducer) ) {
+    // serialization does not preserve the mismatch
+    return input;
+  }
+
+  bool reduced = true;
+  while ( reduced ) {
+    reduced = false;
+    LIMEX::Expression<double> expression(reproducer,handle);
+
+    // collect all operations which may be replaced, outer operations first
+    std::vector<const Node*> nodes;
+    std::vector<const Node*> stack = { &expression.getRoot() };
+    while ( !stack.empty() ) {
+      auto node = stack.back();
+      stack.pop_back();
+      for ( auto& operand : node->operands ) {
+        if ( !std::holds_alternative<Node>(operand) ) continue;
+        auto& child = std::get<Node>(operand);
+        if ( child.operands.empty() || child.type == Type::literal || child.type == Type::variable || child.type == Type::collection ) continue;
+        if ( child.type == Type::set || child.type == Type::sequence || ( child.type == Type::group && node->type == Type::if_then_else ) ) {
+          // groups are required by the then-branch of ternaries
+          stack.push_back(&child);
+          continue;
+        }
+        nodes.push_back(&child);
+        stack.push_back(&child);
+      }
+    }
+
+    for ( auto node : nodes ) {
+      // candidate replacements: any operand of the node, or a literal
+      std::vector<Node> replacements;
+      for ( auto& operand : node->operands ) {
+        if ( std::holds_alternative<Node>(operand) ) {
+          auto& child = std::get<Node>(operand);
+          if ( child.type != Type::collection && child.type != Type::set && child.type != Type::sequence ) {
+            replacements.push_back(child);
+          }
+        }
+      }
+      replacements.emplace_back(node->expression, 0.0);
+      replacements.emplace_back(node->expression, 1.0);
+
+      for ( auto& replacement : replacements ) {
+        // swapping keeps the storage of the original operands and thus the collected nodes valid
+        auto& target = const_cast<Node&>(*node);
+        std::swap(target, replacement);
+        std::string candidate;
+        expression.serialize(candidate);
+        std::swap(target, replacement);
+        try {
+          // parentheses may be added when reparsing, only shorter candidates guarantee progress
+          candidate = LIMEX::Expression<double>(candidate,handle).serialize();
+        }
+        catch ( const std::exception& ) {
+          continue;
+        }
+        if ( candidate.size() < reproducer.size() && mismatch(candidate) ) {
+          reproducer = candidate;
+          reduced = true;
+          break;
+        }
+      }
+      if ( reduced ) {
+        break;
+      }
+    }
+  }
+  return reproducer;
+}
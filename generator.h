@@ -0,0 +1,229 @@
+#include <random>
+#include <string>
+#include <vector>
+#include <charconv>
+
+/**
+ * @brief Generates random expressions together with values for their variables and collections.
+ *
+ * The shape of the expressions is controlled by the maximum depth of nested operations, the number
+ * of arguments of aggregations, the number of distinct names, the size of sets used in membership
+ * tests, the probability of Unicode spellings, and the relative weights of the kinds of operations.
+ * All operands of operators are enclosed in parentheses so that expressions are parsed in the same
+ * way regardless of precedences. Variables and indexed elements of collections are only generated if
+ * the shape provides variables and non-empty collections. For the same seed, the same sequence of expressions and values is
+ * generated with every standard library, as all values are derived directly from the output of the 
+ * engine instead of using distributions whose algorithms are implementation-defined.
+ */
+class Generator {
+public:
+  struct Shape {
+    size_t depth = 4; /// Maximum depth of nested operations
+    size_t fanOut = 3; /// Maximum number of arguments of aggregations
+    size_t variables = 4; /// Number of distinct variables
+    size_t collections = 2; /// Number of distinct collections
+    size_t collectionSize = 8; /// Number of elements of each collection
+    size_t setSize = 4; /// Number of elements of sets used in membership tests
+    double unicode = 0.25; /// Probability of using Unicode spellings of operators and functions
+    double leaf = 0.1; /// Probability of stopping before the maximum depth is reached
+    bool safeDivision = true; /// Divisors are of the form 'abs(...) + 1' to avoid division by zero
+    // Relative weights of the kinds of operations
+    double arithmetic = 4;
+    double comparison = 1;
+    double logical = 1;
+    double ternary = 1;
+    double function = 1;
+    double aggregation = 1;
+    double index = 1;
+    double membership = 1;
+  };
+  Generator(Shape shape, uint64_t seed) : shape(shape), random(seed) {};
+  std::string expression() { return term(shape.depth); }
+  std::vector<double> variableValues(size_t count); /// Values for the given number of variables
+  std::vector< std::vector<double> > collectionValues(size_t count); /// Values for the given number of collections
+private:
+  std::string term(size_t depth);
+  std::string leaf();
+  std::string literal();
+  std::string spell(const char* ascii, const char* unicode) { return chance(shape.unicode) ? unicode : ascii; }
+  double uniform() { return (double)( random() >> 11 ) * 0x1.0p-53; } // value in [0,1) from the upper 53 bits
+  bool chance(double probability) { return uniform() < probability; }
+  size_t pick(size_t count) { return (size_t)( random() % count ); }
+  size_t pick(const std::vector<double>& weights);
+  std::string variable() { return "x" + std::to_string(pick(shape.variables) + 1); }
+  std::string collection() { return "c" + std::to_string(pick(shape.collections) + 1); }
+  Shape shape;
+  std::mt19937_64 random;
+};
+
+size_t Generator::pick(const std::vector<double>& weights) {
+  double total = 0;
+  for ( auto weight : weights ) {
+    total += weight;
+  }
+  double value = uniform() * total;
+  for ( size_t i = 0; i < weights.size(); i++ ) {
+    if ( value < weights[i] ) {
+      return i;
+    }
+    value -= weights[i];
+  }
+  // rounding may leave a remainder, the last choice with positive weight is taken
+  size_t last = weights.size() - 1;
+  while ( last > 0 && weights[last] <= 0 ) {
+    last--;
+  }
+  return last;
+}
+
+std::string Generator::literal() {
+  // multiples of 1/8 have short and exact decimal representations
+  double value = (double)pick(100) / 8;
+  char digits[32];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed);
+  return std::string(digits, result.ptr);
+}
+
+std::string Generator::leaf() {
+  // kinds of leaves without names to pick from are skipped
+  std::vector<size_t> kinds = { 0 };
+  if ( shape.variables ) {
+    kinds.push_back(1);
+  }
+  if ( shape.collections && shape.collectionSize ) {
+    kinds.push_back(2);
+  }
+  size_t choice = kinds[pick(kinds.size())];
+  if ( choice == 0 ) {
+    return literal();
+  }
+  else if ( choice == 1 ) {
+    return variable();
+  }
+  std::string name = collection();
+  return name + "[" + std::to_string(pick(shape.collectionSize) + 1) + "]";
+}
+
+std::string Generator::term(size_t depth) {
+  if ( depth == 0 || chance(shape.leaf) ) {
+    return leaf();
+  }
+  auto operand = [&]() { return "(" + term(depth - 1) + ")"; };
+  size_t kind = pick({
+    shape.arithmetic, shape.comparison, shape.logical, shape.ternary,
+    shape.function, shape.aggregation, shape.collections && shape.collectionSize ? shape.index : 0.0, shape.membership
+  });
+  switch ( kind ) {
+    case 0:
+    {
+      // arithmetic
+      size_t choice = pick(8);
+      std::string left = operand();
+      switch ( choice ) {
+        case 0: return left + " + " + operand();
+        case 1: return left + " - " + operand();
+        case 2: return left + " * " + operand();
+        case 3: return left + " / " + ( shape.safeDivision ? "(abs(" + term(depth - 1) + ") + 1)" : operand() );
+        case 4: return left + "^" + literal();
+        case 5: return "-" + left;
+        case 6: return left + spell("^2", "²");
+        default: return left + spell("^3", "³");
+      }
+    }
+    case 1:
+    {
+      // comparison
+      static const std::vector< std::pair<const char*, const char*> > operators = {
+        { " < ", " < " }, { " <= ", " ≤ " }, { " > ", " > " }, { " >= ", " ≥ " }, { " == ", " == " }, { " != ", " ≠ " }
+      };
+      auto& [ascii, unicode] = operators[pick(operators.size())];
+      std::string left = operand();
+      std::string symbol = spell(ascii, unicode);
+      return left + symbol + operand();
+    }
+    case 2:
+    {
+      // logical
+      size_t choice = pick(3);
+      std::string left = operand();
+      if ( choice == 2 ) {
+        return spell("!", "¬") + left;
+      }
+      std::string symbol = ( choice == 0 ) ? spell(" && ", " ∧ ") : spell(" || ", " ∨ ");
+      return left + symbol + operand();
+    }
+    case 3:
+    {
+      // ternary
+      bool keywords = chance(0.5);
+      std::string condition = operand();
+      std::string consequence = operand();
+      std::string alternative = operand();
+      if ( keywords ) {
+        return "if " + condition + " then " + consequence + " else " + alternative;
+      }
+      return "(" + condition + " ? " + consequence + " : " + alternative + ")";
+    }
+    case 4:
+    {
+      // function
+      size_t choice = pick(4);
+      std::string name = ( choice == 0 ) ? "abs" : ( choice == 1 ) ? spell("sqrt", "√") : ( choice == 2 ) ? spell("cbrt", "∛") : "pow";
+      std::string argument = term(depth - 1);
+      return name + "(" + argument + ( choice == 3 ? ", " + literal() : "" ) + ")";
+    }
+    case 5:
+    {
+      // aggregation
+      static const std::vector<const char*> names = { "sum", "avg", "count", "min", "max" };
+      std::string name = names[pick(names.size())];
+      if ( name == "sum" ) {
+        name = spell("sum", "∑");
+      }
+      if ( shape.collections && chance(0.25) ) {
+        return name + "{" + collection() + "[]}";
+      }
+      std::string arguments = term(depth - 1);
+      for ( size_t i = 1, count = pick(std::max<size_t>(shape.fanOut, 1)) + 1; i < count; i++ ) {
+        arguments += ", " + term(depth - 1);
+      }
+      return name + "{" + arguments + "}";
+    }
+    case 6:
+    {
+      // indexed variable
+      std::string name = collection();
+      return name + "[" + std::to_string(pick(shape.collectionSize) + 1) + "]";
+    }
+    default:
+    {
+      // set membership
+      std::string element = operand();
+      std::string symbol = chance(0.5) ? spell(" in ", " ∈ ") : spell(" not in ", " ∉ ");
+      std::string elements = shape.variables && chance(0.25) ? variable() : literal();
+      for ( size_t i = 1; i < shape.setSize; i++ ) {
+        elements += ", " + ( shape.variables && chance(0.25) ? variable() : literal() );
+      }
+      return element + symbol + "{" + elements + "}";
+    }
+  }
+}
+
+std::vector<double> Generator::variableValues(size_t count) {
+  std::vector<double> values(count);
+  for ( auto& value : values ) {
+    // include values that are elements of generated sets and literals
+    value = chance(0.5) ? (double)pick(100) / 8 : 20 * uniform() - 10;
+  }
+  return values;
+}
+
+std::vector< std::vector<double> > Generator::collectionValues(size_t count) {
+  std::vector< std::vector<double> > values(count, std::vector<double>(shape.collectionSize));
+  for ( auto& collection : values ) {
+    for ( auto& value : collection ) {
+      value = 20 * uniform() - 10;
+    }
+  }
+  return values;
+}
@@ -11,8 +11,33 @@
 #include <functional>
 #include <array>
 #include <stack>
+#include <unordered_map>
 #include <cmath>
 #include <cfloat>
+#include <limits>
+#include <algorithm>
+#include <span>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <list>
+#include <cstring>
+#include <cstdint>
+#include <coroutine>
+#include <utility>
+#include <charconv>
+#include <stop_token>
+#include <bit>
+#include <map>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 /**
  * A library for parsing mathematical expressions
  **/
@@ -25,7 +50,7 @@ namespace LIMEX {
  */
 struct Token {
   enum class Category { PREFIX, OPERAND, POSTFIX, INFIX }; /// Categories of input to be parsed by lexer
-  enum class Type { NUMBER, VARIABLE, COLLECTION, OPERATOR, SEPARATOR, GROUP, SET, SEQUENCE, FUNCTION_CALL, AGGREGATION, INDEXED_VARIABLE };    
+  enum class Type { NUMBER, VARIABLE, COLLECTION, OPERATOR, SEPARATOR, GROUP, SET, SEQUENCE, FUNCTION_CALL, AGGREGATION, INDEXED_VARIABLE, STRING };    
   Token(Category category, Type type, std::string value = "") : category(category), type(type), value(std::move(value)) {}
   Category category;
   Type type;
@@ -35,9 +60,120 @@ struct Token {
 };
 
 enum class Type; /// Types of nodes in the abstract syntax tree
+enum class Notation { AST, INFIX }; /// Abstract syntax tree as given by stringify or infix notation that can be parsed
 
 template <typename T, typename C = std::vector<T> > class Expression;
 
+template <typename T, typename C> class Scheduler;
+template <typename T, typename C> class Archive;
+template <typename T, typename C> class Builder;
+template <typename T, typename C> class Sampler;
+
+/**
+ * @brief Represents a lazily started coroutine computing a value of type T.
+ *
+ * Awaiting a task starts it and resumes the awaiting coroutine once the value is available. 
+ * Exceptions thrown within the task are rethrown when the value is retrieved.
+ */
+template <typename T>
+class Task {
+public:
+  struct promise_type {
+    std::optional<T> value;
+    std::exception_ptr exception;
+    std::coroutine_handle<> continuation;
+    Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept {
+      struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept {
+          // resume the awaiting coroutine, if any
+          auto continuation = coroutine.promise().continuation;
+          return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+      };
+      return FinalAwaiter{};
+    }
+    void return_value(T result) { value.emplace(std::move(result)); }
+    void unhandled_exception() { exception = std::current_exception(); }
+  };
+  Task(Task&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+  Task& operator=(Task&& other) noexcept { std::swap(coroutine, other.coroutine); return *this; }
+  ~Task() { if ( coroutine ) coroutine.destroy(); }
+  inline bool done() const { return coroutine.done(); }
+  inline void start() { coroutine.resume(); }
+  inline T get() {
+    if ( coroutine.promise().exception ) {
+      std::rethrow_exception(coroutine.promise().exception);
+    }
+    return std::move(coroutine.promise().value.value());
+  }
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    coroutine.promise().continuation = awaiting;
+    return coroutine;
+  }
+  T await_resume() { return get(); }
+private:
+  explicit Task(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+  std::coroutine_handle<promise_type> coroutine;
+};
+
+/**
+ * @brief Represents the values of a collection, for use as collection type of expressions.
+ *
+ * A dense collection is accessed by positions starting at 1 in the same way as `std::vector<T>`. A keyed
+ * collection holds values for arbitrary integer keys in an open-addressing hash table with linear probing,
+ * so that sparse lookup tables keyed by large identifiers do not require dense vectors with holes. Indexed 
+ * access `c[i]` of a keyed collection returns the value for key `i`, aggregations use all values in the 
+ * order given. A provided collection does not hold values but fetches each accessed element from a 
+ * @ref `Provider`, so that callers do not need to materialize large collections of which only few 
+ * elements are used.
+ *
+ * @tparam T The type of the values (e.g., double).
+ */
+template <typename T>
+class Collection {
+  static_assert(std::is_arithmetic_v<T>, "LIMEX: Collections require arithmetic values");
+template <typename U, typename D> friend class Expression;
+public:
+  using Key = int64_t;
+  struct Provider {
+    std::function<std::optional<T>(const T&)> element; /// Value at the given position or for the given key, if any
+    std::optional<size_t> size = std::nullopt; /// Number of elements, if known
+    std::function<std::span<const T>()> span = nullptr; /// All values, if available
+  };
+  Collection() = default;
+  Collection(std::vector<T> values) : values(std::move(values)) {};
+  Collection(std::initializer_list<T> values) : values(values) {};
+  // Creates a keyed collection with the value of each key
+  Collection(const std::vector<Key>& keys, std::vector<T> values);
+  // Creates a collection fetching accessed elements from the provider
+  Collection(Provider provider);
+  inline size_t size() const; /// Number of elements, 0 if unknown for provided collections
+  inline bool isKeyed() const { return !slots.empty(); }
+  inline bool isProvided() const { return provider != nullptr; }
+  inline const std::vector<T>& getValues() const { return values; } /// All values in the order given, empty for provided collections
+  inline const std::vector<T>& getValues(std::vector<T>& buffer) const; /// All values, fetched into the buffer for provided collections and counted as work of the current budget
+  inline std::optional<T> find(const T& index) const; /// Value at the given position or for the given key, if any
+  inline T at(const T& index) const; /// Value at the given position or for the given key
+  inline void prefetch(const T& index) const; /// Prefetch the slot of the given key into the cache
+private:
+  struct Slot {
+    Key key = 0;
+    T value = 0;
+    bool occupied = false;
+  };
+  std::vector<T> values;
+  std::vector<Slot> slots; // open-addressing hash table, only used for keyed collections
+  unsigned int shift = 0;
+  std::shared_ptr<const Provider> provider; // only used for provided collections
+  inline static bool toKey(const T& index, Key& key);
+  inline size_t getSlot(Key key) const { return (size_t)( ( (uint64_t)key * 0x9e3779b97f4a7c15ull ) >> shift ); }
+};
+
 /**
  * @brief Represents a node in the abstract syntax tree of an expression.
  * 
@@ -49,41 +185,565 @@ template <typename T, typename C = std::vector<T> > class Expression;
  */
 template <typename T, typename C = std::vector<T> >
 class Node {
+friend class Expression<T,C>;
+friend class Builder<T,C>;
 public:
   Expression<T,C>* expression;
   Type type;
   std::vector< std::variant<double, size_t, Node> > operands;
+  bool quoted = false; // literal or set holding codes of strings, which are written as quoted strings
   // Constructor for a literal node
   Node(Expression<T,C>* expression, double value);
   // Constructor for a variable or collection node
   Node(Expression<T,C>* expression, Type type, std::string name);
   // Constructor for a node with multiple operands
   Node(Expression<T,C>* expression, Type type, std::vector< std::variant<double, size_t, Node> > operands);
-  // Templated deep copy constructor
-  template <typename U>
-  Node(Expression<T,C>* expression, const Node<U>& other);
+  // Templated deep copy constructor remapping indices of callables
+  template <typename U, typename D>
+  Node(Expression<T,C>* expression, const Node<U,D>& other, const std::function<size_t(size_t)>& callable);
   // Evaluate the node
   inline T evaluate( const std::vector<T>& variableValues = {}, const std::vector<C>& collectionValues = {}) const;
+  // Evaluate the node for rows [begin, begin + results.size()) of the given variable columns
+  inline void evaluateBatch( const std::vector< std::vector<T> >& variableColumns, const std::vector<C>& collectionValues, size_t begin, std::span<T> results ) const;
+  // Evaluate the node asynchronously suspending at awaitable callables
+  inline Task<T> evaluateAsync( Scheduler<T,C>& scheduler, const std::vector<T>& variableValues, const std::vector<C>& collectionValues ) const;
+  // Returns true if the node or any of its operands calls an awaitable callable
+  inline bool isAwaitable() const { return awaitable; }
+  // Returns true if all callables used by the node and its operands are pure
+  inline bool isPure() const;
+  // Add the estimated cost of evaluating the node and its operands, with costs per element of each collection
+  inline void estimateCost( double& constant, std::vector<double>& perElement ) const;
+  // Mark collections of which all elements are used and count accesses of single elements of each collection
+  inline void analyzeAccess( std::vector<bool>& scanned, std::vector<size_t>& points ) const;
+  // Replace variables with known values by literals and fold constant subexpressions
+  inline void specialize( const std::vector< std::optional<T> >& constants );
+  // Transform the node and its operands into a canonical form
+  inline void canonicalize();
+  // Returns a structural hash of the node and its operands
+  inline uint64_t hash(uint64_t seed = 0) const;
+  inline std::array<uint64_t,2> hash128() const { return { hash(0), hash(0x5bd1e995) }; }
+  // Returns the element of the collection at the given index value
+  inline T element( const C& collection, const T& value ) const;
   std::string stringify() const;
+  // Append the node in the given notation to the buffer
+  inline void serialize( std::string& buffer, Notation notation ) const;
+  // Replace literal nodes by their values, used for elements of sets, and return true if the values are codes of strings
+  inline static bool pack( std::vector< std::variant<double, size_t, Node> >& operands );
+  // Returns the string in double quotes with quotes and backslashes escaped
+  inline static std::string quote( const std::string& string );
+private:
+  bool awaitable = false; // determined when the node is constructed or bound to an expression
+  // Determine whether the node or any of its operands calls an awaitable callable
+  inline void updateAwaitable();
+  // Set the expression of the node and its operands
+  inline void rebind(Expression<T,C>* expression);
+  // Returns all values of a collection given as vector or as Collection, using the buffer for provided collections, and charges them to the budget
+  inline static const std::vector<T>& getValues( const C& collection, std::vector<T>& buffer );
+  inline static uint64_t mix(uint64_t hash, uint64_t value);
+  // Canonicalize the node and its operands and return the hash of the result
+  inline uint64_t canonicalize(bool unordered);
+  // Returns the hash of the node using the given hashes of its operands
+  template <typename F>
+  inline uint64_t hash(uint64_t seed, F&& hashOperand) const;
+  inline static uint64_t fingerprint(const std::string& name);
+};
+
+/**
+ * @brief Describes properties of a callable.
+ *
+ * The properties allow analyses and transformations to treat custom callables in the same way as 
+ * built-in callables. Properties which are not known must be left at their conservative defaults.
+ */
+template <typename T>
+struct Descriptor {
+  enum class Monotonicity { NONE, INCREASING, DECREASING }; /// Monotonicity of the result in each argument
+  size_t minArity = 0; /// Minimal number of arguments
+  size_t maxArity = std::numeric_limits<size_t>::max(); /// Maximal number of arguments
+  bool pure = false; /// Result only depends on the arguments and calls have no side effects
+  bool commutative = false; /// Arguments can be reordered without changing the result
+  bool exactlyCommutative = false; /// Arguments can be reordered without changing the result, even by rounding
+  Monotonicity monotonicity = Monotonicity::NONE;
+  std::function<void(const std::vector< std::span<const T> >&, std::span<T>)> column = nullptr; /// Column-wise implementation
+  std::function<T(const std::vector<T>&, size_t)> derivative = nullptr; /// Partial derivative with respect to the given argument
+  std::function<std::pair<T,T>(const std::vector< std::pair<T,T> >&)> interval = nullptr; /// Bounds of the result given bounds of the arguments
+  double cost = 1.0; /// Relative cost of a call compared to an arithmetic operation
 };
 
+/**
+ * @brief Provides the callables available in expressions.
+ *
+ * Built-in callables are registered once per value and collection type in an immutable layer shared
+ * by all handles. Custom callables are added to an overlay owned by the handle. Copies of a handle
+ * share the overlay until a callable is added to one of them. Whether the overlay is shared is decided
+ * by its reference count, hence a handle must not be copied while a callable is added to it or to a 
+ * handle sharing its overlay. Handles can be used concurrently as long as no callable is added.
+ *
+ * String literals in expressions are replaced by integer codes of a dictionary which is shared by
+ * all copies of a handle. Codes start at 1, so that 0 can be used for strings not in the dictionary.
+ * As all unknown strings share the code 0, variables representing strings should be bound by 
+ * @ref `encode`, which gives NaN for unknown strings so that they differ from every string.
+ */
 template <typename T, typename C = std::vector<T> >
 class Handle {
 friend class Node<T,C>;
 friend class Expression<T,C>;
+friend class Scheduler<T,C>;
+template <typename U, typename D> friend class Handle;
 public:
-  Handle() { initialize(); };
+  Handle() : builtins(&getBuiltins()), dictionary(std::make_shared<Dictionary>()) {};
   inline void add(const std::string& name, std::function<T(const std::vector<T>&)> implementation);
-  inline const std::vector<std::string>& getNames() const { return names; }
+  inline void add(const std::string& name, std::function<T(const std::vector<T>&)> implementation, std::function<void(const std::vector< std::span<const T> >&, std::span<T>)> columnImplementation);
+  inline void add(const std::string& name, std::function<T(const std::vector<T>&)> implementation, Descriptor<T> descriptor);
+  inline const Descriptor<T>& getDescriptor(size_t index) const { return getCallable(index).descriptor; }
+  inline void validate(size_t index, size_t arguments) const;
+  inline void addAwaitable(const std::string& name, std::function<std::vector<T>(const std::vector< std::vector<T> >&)> bulkImplementation);
+  inline bool isAwaitable(size_t index) const { return index < size() && getCallable(index).awaitable; }
+  inline size_t size() const { return builtins->callables.size() + ( overlay ? overlay->callables.size() : 0 ); }
+  inline std::vector<std::string> getNames() const; // Returns a copy of the names of all callables, built-in callables first
+  inline const std::string& getName(size_t index) const { return getCallable(index).name; }
   inline size_t getIndex(const std::string& name) const;
   inline T indexedEvaluation( const C& collection, const T& index ) const; 
   inline T aggregateEvaluation( const std::string& name, const C& collection ) const; 
+  // Returns the code of the string, adding the string to the dictionary if necessary
+  inline size_t intern(const std::string& string) const;
+  // Returns the code of the string, or 0 if the string is not in the dictionary
+  inline size_t getCode(const std::string& string) const;
+  // Returns the value of a variable representing the string, which is its code or NaN if the string is not in the dictionary
+  inline double encode(const std::string& string) const;
+  inline std::string getString(size_t code) const;
 private:
+  struct Callable {
+    std::string name;
+    std::function<T(const std::vector<T>&)> implementation;
+    std::function<std::vector<T>(const std::vector< std::vector<T> >&)> awaitable;
+    Descriptor<T> descriptor;
+  };
+  struct Layer {
+    std::vector<Callable> callables;
+    std::unordered_map<std::string, size_t> indices; // index of each callable within the layer
+  };
+  struct Dictionary {
+    std::shared_mutex mutex;
+    std::vector<std::string> strings; // string of each code - 1
+    std::unordered_map<std::string, size_t> codes;
+  };
+  explicit Handle(const Layer* builtins) : builtins(builtins), dictionary(std::make_shared<Dictionary>()) {};
+  inline static const Layer& getBuiltins();
   inline void initialize();
-  std::vector<std::function<T(const std::vector<T>&)>> implementations;
-  std::vector<std::string> names;
+  inline const Callable& getCallable(size_t index) const;
+  inline T call(size_t index, const std::vector<T>& arguments) const { return getCallable(index).implementation(arguments); }
+  const Layer* builtins;
+  std::shared_ptr<Layer> overlay;
+  std::shared_ptr<Dictionary> dictionary;
+};
+
+/**
+ * @brief Schedules asynchronous evaluations of expressions calling awaitable callables.
+ *
+ * All submitted evaluations are started by @ref `run` and suspend when calling an awaitable callable. 
+ * Once no evaluation can proceed, all pending calls of the same awaitable callable are passed to its 
+ * bulk implementation at once and the suspended evaluations are resumed with the respective results.
+ */
+template <typename T, typename C = std::vector<T> >
+class Scheduler {
+public:
+  // Awaitable call of a callable that is resolved together with other pending calls
+  struct Call {
+    Scheduler* scheduler;
+    const Handle<T,C>* handle;
+    size_t callable;
+    std::vector<T> arguments;
+    std::optional<T> result;
+    std::exception_ptr exception;
+    std::coroutine_handle<> continuation;
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> awaiting) { continuation = awaiting; scheduler->pending.push_back(this); }
+    T await_resume() {
+      if ( exception ) {
+        std::rethrow_exception(exception);
+      }
+      return std::move(result.value());
+    }
+  };
+  inline size_t submit(const Expression<T,C>& expression, std::vector<T> variableValues = {}, std::vector<C> collectionValues = {});
+  inline void run();
+  inline T get(size_t evaluation);
+  inline size_t getBulkCalls() const { return bulkCalls; }
+private:
+  struct Evaluation {
+    std::vector<T> variableValues;
+    std::vector<C> collectionValues;
+    std::optional< Task<T> > task;
+  };
+  std::vector< std::unique_ptr<Evaluation> > evaluations;
+  std::vector<Call*> pending;
+  size_t bulkCalls = 0;
+};
+
+/**
+ * @brief Represents a versioned set of expressions that can be replaced while being evaluated.
+ *
+ * A new set of expressions is parsed by @ref `publish` and made visible to readers by a single atomic 
+ * pointer swap. Readers pin the current set by acquiring a @ref `Snapshot` without taking a lock. 
+ * Reader counts are striped across threads and split by the parity of an epoch, so that the writer can 
+ * wait for readers of a previous set to finish before reclaiming it.
+ */
+template <typename T, typename C = std::vector<T> >
+class Registry {
+public:
+  class Rules {
+  public:
+    inline size_t getVersion() const { return version; }
+    inline size_t size() const { return expressions.size(); }
+    inline const std::vector<std::string>& getNames() const { return names; }
+    inline const Expression<T,C>& operator[](size_t index) const { return *expressions[index]; }
+    inline const Expression<T,C>& at(const std::string& name) const;
+  private:
+    friend class Registry;
+    size_t version = 0;
+    std::vector<std::string> names;
+    std::vector< std::unique_ptr< Expression<T,C> > > expressions;
+  };
+  class Snapshot {
+  public:
+    Snapshot(Snapshot&& other) noexcept : counter(std::exchange(other.counter, nullptr)), rules(other.rules) {}
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+    ~Snapshot() { if ( counter ) counter->fetch_sub(1); }
+    inline const Rules& operator*() const { return *rules; }
+    inline const Rules* operator->() const { return rules; }
+  private:
+    friend class Registry;
+    Snapshot(std::atomic<size_t>* counter, const Rules* rules) : counter(counter), rules(rules) {}
+    std::atomic<size_t>* counter;
+    const Rules* rules;
+  };
+  Registry(const Handle<T,C>& handle);
+  ~Registry();
+  Registry(const Registry&) = delete;
+  Registry& operator=(const Registry&) = delete;
+  inline Snapshot acquire() const;
+  inline size_t publish(const std::vector< std::pair<std::string,std::string> >& rules);
+private:
+  static constexpr size_t STRIPES = 64;
+  struct alignas(64) Stripe {
+    std::atomic<size_t> readers[2] = {0, 0}; // readers per parity of the epoch
+  };
+  inline static size_t getStripe();
+  inline void synchronize();
+  const Handle<T,C>& handle;
+  mutable std::array<Stripe, STRIPES> stripes;
+  std::atomic<size_t> epoch = 0;
+  std::atomic<const Rules*> current;
+  std::mutex publishing; // serializes writers
+};
+
+/**
+ * @brief Represents a store keeping rarely used expressions in a compact encoding.
+ *
+ * Each expression is encoded as a sequence of bytes with variable-length integers, and names of 
+ * variables and collections are interned in a table shared by all expressions of the archive. 
+ * Expressions are inflated upon request and kept in a least-recently-used cache whose memory 
+ * consumption is bounded by a given budget.
+ */
+template <typename T, typename C = std::vector<T> >
+class Archive {
+public:
+  struct Statistics {
+    size_t hits = 0; /// Requests served from the cache
+    size_t misses = 0; /// Requests requiring inflation
+    size_t evictions = 0; /// Inflated expressions removed from the cache
+    size_t encodedBytes = 0; /// Memory used by encoded expressions and interned names
+    size_t inflatedBytes = 0; /// Estimated memory used by inflated expressions in the cache
+  };
+  Archive(const Handle<T,C>& handle, size_t budget);
+  inline size_t add(const Expression<T,C>& expression);
+  inline size_t add(const std::string& input) { return add(Expression<T,C>(input, handle)); }
+  inline std::shared_ptr<const Expression<T,C>> get(size_t id);
+  inline void setBudget(size_t bytes);
+  inline Statistics getStatistics() const;
+  inline static size_t estimate(const Node<T,C>& node);
+private:
+  struct Entry {
+    std::shared_ptr<const Expression<T,C>> expression;
+    std::list<size_t>::iterator position;
+    size_t bytes;
+  };
+  inline size_t intern(const std::string& name);
+  inline static void encode(std::vector<uint8_t>& bytes, uint64_t value);
+  inline static uint64_t decode(const uint8_t*& position);
+  inline void encode(std::vector<uint8_t>& bytes, const Node<T,C>& node);
+  inline Node<T,C> decode(Expression<T,C>* expression, const uint8_t*& position) const;
+  inline void evict();
+  const Handle<T,C>& handle;
+  size_t budget;
+  std::vector<std::string> names; // interned names
+  std::unordered_map<std::string, size_t> ids;
+  std::vector< std::vector<uint8_t> > records;
+  std::list<size_t> recent; // inflated expressions, most recently used first
+  std::unordered_map<size_t, Entry> cache;
+  Statistics statistics;
+  mutable std::mutex mutex;
+};
+
+/**
+ * @brief Builds expressions from terms without formatting and parsing text.
+ *
+ * Terms are nodes of the abstract syntax tree which are validated in the same way as by the parser. 
+ * Names of variables and collections are registered in the order in which terms referring to them are 
+ * created. Building an expression consumes the registered names, terms created before building must 
+ * therefore not be used for further expressions.
+ */
+template <typename T, typename C = std::vector<T> >
+class Builder {
+public:
+  using Term = Node<T,C>;
+  Builder(const Handle<T,C>& handle) : handle(handle) {};
+  inline Term literal(double value) const { return Term(nullptr, value); }
+  inline Term string(const std::string& value) const; // literal with the code of the string
+  inline Term variable(const std::string& name);
+  inline Term collection(const std::string& name);
+  inline Term set(std::vector<Term> elements) const;
+  inline Term unary(Type type, Term operand) const; // negate, logical_not, square, or cube
+  inline Term binary(Type type, Term left, Term right) const; // infix operators except assignments
+  inline Term ternary(Term condition, Term thenTerm, Term elseTerm) const;
+  inline Term call(size_t index, std::vector<Term> arguments) const;
+  inline Term call(const std::string& name, std::vector<Term> arguments) const { return call(handle.getIndex(name), std::move(arguments)); }
+  inline Term aggregate(size_t index, std::vector<Term> arguments) const;
+  inline Term aggregate(const std::string& name, std::vector<Term> arguments) const { return aggregate(handle.getIndex(name), std::move(arguments)); }
+  inline Term aggregate(size_t index, const std::string& collection); // aggregation over all elements of a collection
+  inline Term aggregate(const std::string& name, const std::string& collection) { return aggregate(handle.getIndex(name), collection); }
+  inline Term index(const std::string& collection, Term position);
+  inline Expression<T,C> build(Term root);
+  inline Expression<T,C> build(const std::string& target, Type type, Term value); // assign, add_assign, subtract_assign, multiply_assign, or divide_assign
+private:
+  using Operands = std::vector< std::variant<double, size_t, Term> >;
+  inline static size_t getIndex(std::vector<std::string>& container, const std::string& name);
+  inline static Operands toOperands(std::vector<Term>& terms, std::optional<size_t> index = std::nullopt);
+  inline static void bind(Term& term, Expression<T,C>* expression);
+  const Handle<T,C>& handle;
+  std::vector<std::string> variables;
+  std::vector<std::string> collections;
+};
+
+/**
+ * @brief Records evaluations of expressions exceeding a latency threshold.
+ *
+ * A sampler can be attached to any number of expressions by @ref `Expression::sample`. For each evaluation
+ * taking at least the threshold, the input string, the variable values, the sizes of the collections,
+ * and the inclusive durations of the most expensive subexpressions are stored in a bounded ring buffer.
+ * The breakdown is obtained by evaluating subexpressions again with the same values, outermost first,
+ * descending into the slowest subexpression of each level, and is only determined for pure expressions.
+ * Only the subexpressions which are kept are serialized. Expressions without input string, e.g. built
+ * expressions, are recorded in infix notation. Writers never wait: if a slot of the ring buffer is in
+ * use by another writer or by @ref `dump`, the sample is dropped.
+ */
+template <typename T, typename C = std::vector<T> >
+class Sampler {
+public:
+  struct Timing {
+    std::string subexpression;
+    size_t depth; /// Depth of the subexpression in the tree
+    std::chrono::nanoseconds duration; /// Inclusive duration of evaluating the subexpression
+  };
+  struct Sample {
+    std::string input;
+    std::chrono::nanoseconds duration;
+    std::vector< std::pair<std::string, T> > variables;
+    std::vector< std::pair<std::string, size_t> > collections; /// Names and sizes of collections
+    std::vector<Timing> timings; /// Most expensive subexpressions first, empty for impure expressions
+  };
+  Sampler(std::chrono::nanoseconds threshold, size_t capacity = 64, size_t timings = 16);
+  inline std::chrono::nanoseconds getThreshold() const { return threshold; }
+  inline void record( const Expression<T,C>& expression, std::chrono::nanoseconds duration, const std::vector<T>& variableValues, const std::vector<C>& collectionValues );
+  inline std::vector<Sample> dump(); /// Removes and returns all samples, oldest first
+  inline size_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+private:
+  struct Slot {
+    std::atomic<bool> busy = false;
+    uint64_t sequence = 0;
+    std::optional<Sample> sample;
+  };
+  const std::chrono::nanoseconds threshold;
+  const size_t timings; // maximum number of timings per sample
+  std::vector<Slot> slots;
+  std::atomic<uint64_t> next = 0;
+  std::atomic<size_t> dropped = 0;
+};
+
+/**
+ * @brief Exception raised when an evaluation is aborted because of a @ref `Budget`.
+ */
+class Cancelled : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Limits all evaluations of the calling thread during its lifetime by a deadline and a stop token.
+ *
+ * Nodes evaluated by the thread are counted as work, aggregations of collections are counted with the
+ * size of the collection, while elements are fetched for provided collections, and batch evaluations
+ * with the number of rows. Whenever the given interval
+ * of work is used up, and before the first evaluated node, the deadline and the stop token are checked
+ * and @ref `Cancelled` is raised if the deadline has passed or stop is requested. A single call of a
+ * callable is not interrupted. Budgets can be nested, the innermost budget applies. Workers of a
+ * @ref `Pool` evaluating a batch inherit the budget of the calling thread.
+ */
+class Budget {
+public:
+  using Clock = std::chrono::steady_clock;
+  Budget(Clock::time_point deadline, std::stop_token token = {}, size_t interval = 1024);
+  Budget(Clock::duration timeout, std::stop_token token = {}, size_t interval = 1024) : Budget(Clock::now() + timeout, std::move(token), interval) {};
+  Budget(std::stop_token token, size_t interval = 1024) : Budget(Clock::time_point::max(), std::move(token), interval) {};
+  ~Budget() { current = previous; }
+  Budget(const Budget&) = delete;
+  Budget& operator=(const Budget&) = delete;
+  inline Clock::time_point getDeadline() const { return deadline; }
+  inline const std::stop_token& getToken() const { return token; }
+  inline size_t getInterval() const { return interval; }
+  inline static const Budget* getCurrent() { return current; }
+  inline static void charge(size_t work = 1); /// Count work of the calling thread against the current budget, if any
+private:
+  inline void check();
+  Clock::time_point deadline;
+  std::stop_token token;
+  size_t interval;
+  size_t remaining = 1; // work until the next check
+  Budget* previous;
+  inline static thread_local Budget* current = nullptr;
 };
 
+/**
+ * @brief Represents a pool of worker threads used for parallel batch evaluation.
+ *
+ * Workers are distributed round-robin over the NUMA nodes reported by the operating system and,
+ * where supported, pinned to the CPUs of their node. Rows of a batch are split into contiguous
+ * chunks, one per worker. Results should be written to memory that has not yet been touched
+ * (e.g. allocated by `std::make_unique_for_overwrite`) so that each page is placed on the node of
+ * the worker writing it. Input columns can be placed in the same way by filling them within
+ * @ref `run` using the ranges given by @ref `getRange`. Concurrent calls of @ref `run` are executed
+ * one after another, calls from within a task of the same pool are rejected.
+ */
+class Pool {
+public:
+  struct Statistics { size_t rows = 0; std::chrono::nanoseconds duration{0}; }; /// Rows evaluated and time spent
+  Pool(size_t size = std::thread::hardware_concurrency());
+  ~Pool();
+  Pool(const Pool&) = delete;
+  Pool& operator=(const Pool&) = delete;
+  inline size_t size() const { return workers.size(); }
+  inline size_t getNodes() const { return cpus.size(); }
+  inline size_t getNode(size_t worker) const { return worker % cpus.size(); }
+  inline std::pair<size_t,size_t> getRange(size_t worker, size_t rows) const;
+  inline void run(const std::function<void(size_t worker)>& task);
+  inline void record(size_t worker, size_t rows, std::chrono::nanoseconds duration);
+  inline std::vector<Statistics> getStatistics() const; /// Statistics per NUMA node
+  inline void resetStatistics();
+private:
+  inline static std::vector< std::vector<int> > discover();
+  inline void work(size_t worker);
+  std::vector< std::vector<int> > cpus; // CPUs per NUMA node
+  std::vector<std::thread> workers;
+  std::vector<Statistics> statistics; // per worker
+  std::mutex running; // serializes calls of run
+  std::mutex mutex;
+  std::condition_variable started;
+  std::condition_variable finished;
+  const std::function<void(size_t)>* task = nullptr;
+  size_t generation = 0;
+  size_t pending = 0;
+  bool stopping = false;
+  std::exception_ptr exception;
+  inline static thread_local const Pool* owner = nullptr; // pool of the worker executing the current thread
+};
+
+#ifdef LIMEX_METRICS
+/**
+ * @brief Collects process-wide metrics on parsing and evaluation of expressions.
+ *
+ * Metrics are only collected if `LIMEX_METRICS` is defined before including this file and if they are
+ * enabled at runtime. Each thread records into its own counters and histograms, which are merged when
+ * a @ref `Snapshot` is taken. Evaluation latencies are measured for one out of every `samplingPeriod`
+ * evaluations of a thread so that the clock is not read for every evaluation. Latencies per expression
+ * are only recorded if requested, for at most the given number of distinct expressions per thread, 
+ * which are identified by their structural hash.
+ */
+class Metrics {
+public:
+  enum class Category { DIVISION_BY_ZERO, ILLEGAL_INDEX, MISSING_VALUES, PARSING, CANCELLED, OTHER, COUNT }; /// Categories of errors
+  /**
+   * @brief Counts values in log-linear buckets with a relative error of at most 1/8.
+   */
+  class Histogram {
+  public:
+    static constexpr size_t SUB_BUCKETS = 8; /// Buckets per power of two
+    static constexpr size_t BUCKETS = 62 * SUB_BUCKETS;
+    inline void record(uint64_t value);
+    inline void merge(const Histogram& other);
+    inline void reset();
+    inline uint64_t getCount() const;
+    inline uint64_t getPercentile(double percentile) const; /// Upper bound of the bucket containing the percentile
+    inline std::vector< std::pair<uint64_t,uint64_t> > getBuckets() const; /// Upper bounds and counts of non-empty buckets
+    inline static size_t bucket(uint64_t value);
+    inline static uint64_t upper(size_t bucket);
+  private:
+    std::array<uint64_t, BUCKETS> counts = {};
+  };
+  struct Profile {
+    std::string expression; /// Input string, or infix notation for expressions without input
+    Histogram duration; /// Nanoseconds per sampled evaluation
+  };
+  struct Snapshot {
+    uint64_t parses = 0; /// Trees built from input strings
+    uint64_t evaluations = 0; /// Calls of `Expression::evaluate`
+    uint64_t batches = 0; /// Calls of `Expression::evaluateBatch`
+    uint64_t rows = 0; /// Rows evaluated in batches
+    std::array<uint64_t, (size_t)Category::COUNT> errors = {}; /// Exceptions raised per category
+    Histogram parseDuration; /// Nanoseconds per parse
+    Histogram evaluationDuration; /// Nanoseconds per sampled evaluation
+    Histogram aggregationSize; /// Number of values passed to aggregations
+    std::map<uint64_t, Profile> expressions; /// Profiles of tracked expressions by their hash
+  };
+  inline static void enable(size_t samplingPeriod = 64, size_t expressions = 0); /// Track at most the given number of expressions per thread
+  inline static void disable() { enabled.store(false, std::memory_order_relaxed); }
+  inline static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+  inline static Snapshot snapshot();
+  inline static void reset();
+  inline static Category categorize(const std::exception& exception);
+  inline static void recordParse(std::chrono::nanoseconds duration);
+  inline static void recordError(Category category) { increment(local().errors[(size_t)category]); }
+  inline static void recordAggregation(size_t size) { local().aggregationSize.record(size); }
+  template <typename E, typename F>
+  inline static auto measure(const E& expression, F&& evaluate);
+  template <typename F>
+  inline static void measureBatch(size_t rows, F&& evaluate);
+private:
+  // Metrics of a single thread, only modified by that thread
+  struct Local {
+    uint64_t parses = 0;
+    uint64_t evaluations = 0;
+    uint64_t batches = 0;
+    uint64_t rows = 0;
+    std::array<uint64_t, (size_t)Category::COUNT> errors = {};
+    Histogram parseDuration;
+    Histogram evaluationDuration;
+    Histogram aggregationSize;
+    size_t countdown = 1; // evaluations until the next sample
+    std::mutex mutex; // guards expressions
+    std::unordered_map<uint64_t, Profile> expressions;
+  };
+  inline static Local& local();
+  inline static void increment(uint64_t& counter, uint64_t value = 1);
+  inline static uint64_t load(const uint64_t& counter);
+  inline static std::atomic<bool> enabled = false;
+  inline static std::atomic<size_t> samplingPeriod = 64;
+  inline static std::atomic<size_t> expressionLimit = 0; // tracked expressions per thread
+  inline static std::mutex mutex; // guards locals
+  inline static std::vector< std::shared_ptr<Local> > locals; // locals of all threads that recorded metrics
+};
+#endif
+
 /**
  * @brief Represents a mathematical expression that can be evaluated for different values.
  * 
@@ -99,23 +759,138 @@ private:
 template <typename T, typename C >
 class Expression {
 friend class Node<T,C>;
+template <typename U, typename D> friend class Node;
+friend class Archive<T,C>;
+friend class Builder<T,C>;
+template <typename U, typename D> friend class Expression;
+#ifdef LIMEX_METRICS
+friend class Metrics;
+#endif
 public:
-  Expression(const std::string& expression, const Handle<T,C>& handle);
+  enum class PARSING { EAGER, LAZY }; /// Lazy parsing only scans for names and defers building the tree until first use
+  Expression(const std::string& expression, const Handle<T,C>& handle, PARSING parsing = PARSING::EAGER);
+  // Creates a copy of an expression using callables of the given handle with the same names
+  template <typename U, typename D>
+  Expression(const Expression<U,D>& other, const Handle<T,C>& handle);
+  // Moves an expression and rebinds its tree to the new location, must not be used during a concurrent evaluation
+  Expression(Expression<T,C>&& other) noexcept;
   enum class BUILTIN { IF_THEN_ELSE, N_ARY_IF, ABS, POW, SQRT, CBRT, SUM, AVG, COUNT, MIN, MAX, ELEMENT_OF, NOT_ELEMENT_OF, AT, BUILTINS };
   inline const std::vector<std::string>& getVariables() const { return variables; }
   inline const std::vector<std::string>& getCollections() const { return collections; }
   inline const std::optional<std::string>& getTarget() const { return target; }
   inline T evaluate( const std::vector<T>& variableValues = {}, const std::vector<C>& collectionValues = {}) const;
-  inline const Node<T,C>& getRoot() const { return root; }
+  inline std::vector<T> evaluateBatch( const std::vector< std::vector<T> >& variableColumns, const std::vector<C>& collectionValues = {}) const;
+  inline void evaluateBatch( Pool& pool, std::span<T> results, const std::vector< std::vector<T> >& variableColumns, const std::vector<C>& collectionValues = {}) const;
+  inline Task<T> evaluateAsync( Scheduler<T,C>& scheduler, const std::vector<T>& variableValues, const std::vector<C>& collectionValues ) const { return getRoot().evaluateAsync(scheduler,variableValues,collectionValues); }
+  inline const Node<T,C>& getRoot() const;
+  struct CacheStatistics { 
+    size_t hits = 0; 
+    size_t misses = 0; 
+    size_t bypasses = 0; // evaluations with provided collections or with more elements than can be hashed
+    inline double getHitRatio() const { return hits + misses ? (double)hits / (hits + misses) : 0.0; }
+  };
+  inline void enableCache(size_t capacity, size_t elements = 1024);
+  inline void clearCache();
+  inline CacheStatistics getCacheStatistics() const;
+  struct SpecializationStatistics { 
+    std::vector<std::string> constants; // variables assumed to be constant
+    size_t hits = 0; // evaluations passing the guard
+    size_t failures = 0; // evaluations failing the guard
+  };
+  inline void enableSpecialization(size_t observations = 64);
+  inline SpecializationStatistics getSpecializationStatistics() const;
+  struct Cost {
+    double constant = 0; /// Cost independent of the sizes of collections
+    std::vector< std::pair<std::string, double> > perElement; /// Cost per element of each collection in the order of getCollections()
+    inline double estimate( const std::vector<size_t>& sizes ) const; /// Estimated cost for the given sizes of collections
+    inline double estimate( size_t size ) const { return estimate( std::vector<size_t>(perElement.size(), size) ); } /// Estimated cost if all collections have the given size
+    inline std::string stringify() const; /// Symbolic form in terms of the sizes of collections, e.g. "12 + 3·|c|"
+  }; /// Relative cost of an evaluation, in units of arithmetic operations
+  inline Cost estimateCost() const;
+  struct Access {
+    bool scanned = false; /// All elements are used by an aggregation or by an n-ary if statement for indexed access
+    size_t points = 0; /// Number of accesses of single elements
+  }; /// Access of the elements of a collection
+  inline std::vector<Access> getCollectionAccess() const; /// Access of each collection in the order of getCollections()
+  inline void sample(std::shared_ptr< Sampler<T,C> > sampler) { this->sampler = std::move(sampler); } /// Record slow evaluations, if a sampler is given
+  inline void canonicalize();
+  inline uint64_t hash() const;
+  inline std::array<uint64_t,2> hash128() const;
   const std::string input;
   inline std::string stringify() const;
+  inline void serialize( std::string& buffer, Notation notation = Notation::INFIX ) const;
+  inline std::string serialize( Notation notation = Notation::INFIX ) const;
 private:
   const Handle<T,C>& handle;
   std::vector<std::string> variables;
   std::vector<std::string> collections;
   std::optional<std::string> target;
-  Node<T,C> root;
+  const bool lazy;
+  struct Names {
+    std::vector<std::string> variables;
+    std::vector<std::string> collections;
+    std::optional<std::string> target;
+  };
+  Names* building = nullptr; // name tables filled while the tree of a lazily parsed expression is built
+  inline std::vector<std::string>& getVariableNames() { return building ? building->variables : variables; }
+  inline std::vector<std::string>& getCollectionNames() { return building ? building->collections : collections; }
+  inline std::optional<std::string>& getTargetName() { return building ? building->target : target; }
+  struct Once {
+    std::once_flag flag;
+    std::atomic<bool> done = false;
+    Once() = default;
+    Once(Once&& other) noexcept : done(other.done.load()) {}
+  };
+  mutable Once built; // set when the tree of a lazily parsed expression is built
+  mutable Node<T,C> root;
+#ifdef LIMEX_METRICS
+  mutable std::atomic<uint64_t> structure = 0; // structural hash of the tree once determined for metrics, 0 if not determined
+#endif
+  struct Cache {
+    static constexpr size_t SHARDS = 16;
+    struct Entry {
+      std::vector<T> variableValues;
+      std::vector<uint64_t> collections; // fingerprint of the contents of each collection
+      T result;
+      std::list<uint64_t>::iterator position; // position of the key in the recency list
+    };
+    struct Shard {
+      std::mutex mutex;
+      std::unordered_map<uint64_t, Entry> entries;
+      std::list<uint64_t> recency; // keys from the most to the least recently used entry
+    };
+    size_t capacity; // per shard
+    size_t elements; // maximal number of collection elements hashed per evaluation
+    std::array<Shard, SHARDS> shards;
+    std::atomic<size_t> hits = 0;
+    std::atomic<size_t> misses = 0;
+    std::atomic<size_t> bypasses = 0;
+  };
+  mutable std::unique_ptr<Cache> cache;
+  inline T evaluateCached( const std::vector<T>& variableValues, const std::vector<C>& collectionValues) const;
+  inline static std::optional<uint64_t> fingerprint( const C& collection, size_t& elements );
+  struct Specialization {
+    size_t observations; // number of evaluations before specializing
+    std::mutex mutex;
+    size_t observed = 0;
+    std::vector< std::optional<T> > constants; // values of variables which did not change so far
+    std::atomic<bool> ready = false;
+    std::optional< Node<T,C> > root; // specialized root, only set if any variable is constant
+    std::vector< std::pair<size_t, T> > guards; // variable index and assumed value
+    std::atomic<size_t> hits = 0;
+    std::atomic<size_t> failures = 0;
+  };
+  mutable std::unique_ptr<Specialization> specialization;
+  inline void observe( const std::vector<T>& variableValues ) const;
+  inline T evaluateRoot( const std::vector<T>& variableValues, const std::vector<C>& collectionValues) const;
+  std::shared_ptr< Sampler<T,C> > sampler;
+  inline T evaluateSampled( const std::vector<T>& variableValues, const std::vector<C>& collectionValues) const;
+  // Constructor for an expression with a tree that is already built
+  Expression(const Handle<T,C>& handle, std::vector<std::string> variables, std::vector<std::string> collections, std::optional<std::string> target, const std::function<Node<T,C>(Expression<T,C>*)>& build);
   inline Node<T,C> parse();
+  inline Node<T,C> scan();
+  inline void scan(const std::vector<Token>& tokens);
+  inline static bool isDefinition(const std::vector<Token>& tokens);
   inline static Token tokenize(const std::string& input);
   inline static bool isnumeric(char c) { return (std::isdigit( c ) || c == '.'); }; 
   inline static bool isalphanumeric(char c) { return (std::isalnum(c) || c == '_'); }; 
@@ -341,6 +1116,7 @@ inline std::string Token::stringify(int indent) const {
     case Type::FUNCTION_CALL: result += "FUNCTION_CALL"; break;
     case Type::AGGREGATION: result += "AGGREGATION"; break;
     case Type::INDEXED_VARIABLE: result += "INDEXED_VARIABLE"; break;
+    case Type::STRING: result += "STRING"; break;
   }
   result += ", Value: " + value + '\n';
 
@@ -353,10 +1129,146 @@ inline std::string Token::stringify(int indent) const {
 }
 
 
+/*******************************
+ ** Collection
+ *******************************/
+
+template <typename T>
+Collection<T>::Collection(const std::vector<Key>& keys, std::vector<T> values)
+: values(std::move(values))
+{
+  if ( keys.size() != this->values.size() ) {
+    throw std::invalid_argument("LIMEX: Number of keys and values of collection differ");
+  }
+  // at most half of the slots are occupied
+  size_t capacity = std::bit_ceil( std::max<size_t>(2 * keys.size(), 2) );
+  shift = 64 - (unsigned int)std::countr_zero(capacity);
+  slots.resize(capacity);
+  for ( size_t i = 0; i < keys.size(); i++ ) {
+    size_t index = getSlot(keys[i]);
+    while ( slots[index].occupied ) {
+      if ( slots[index].key == keys[i] ) {
+        throw std::invalid_argument("LIMEX: Duplicate key " + std::to_string(keys[i]) + " of collection");
+      }
+      index = ( index + 1 ) & ( capacity - 1 );
+    }
+    slots[index] = Slot{ keys[i], this->values[i], true };
+  }
+}
+
+template <typename T>
+Collection<T>::Collection(Provider provider)
+{
+  if ( !provider.element ) {
+    throw std::invalid_argument("LIMEX: Provider of collection requires an element accessor");
+  }
+  this->provider = std::make_shared<const Provider>(std::move(provider));
+}
+
+template <typename T>
+inline size_t Collection<T>::size() const {
+  if ( !provider ) {
+    return values.size();
+  }
+  if ( provider->size.has_value() ) {
+    return provider->size.value();
+  }
+  return provider->span ? provider->span().size() : 0;
+}
+
+template <typename T>
+inline const std::vector<T>& Collection<T>::getValues(std::vector<T>& buffer) const {
+  if ( !provider ) {
+    Budget::charge(values.size());
+    return values;
+  }
+  if ( provider->span ) {
+    // callables take vectors, so that the values of the span are copied once per aggregation
+    auto span = provider->span();
+    Budget::charge(span.size());
+    buffer.assign(span.begin(), span.end());
+  }
+  else if ( provider->size.has_value() ) {
+    // fetch all elements by their positions, each fetch is charged so that the budget can cancel before all are fetched
+    buffer.resize(provider->size.value());
+    for ( size_t i = 0; i < buffer.size(); i++ ) {
+      Budget::charge();
+      buffer[i] = at( T(i + 1) );
+    }
+  }
+  else {
+    throw std::runtime_error("LIMEX: Provided collection without size or span cannot be aggregated");
+  }
+  return buffer;
+}
+
+template <typename T>
+inline bool Collection<T>::toKey(const T& index, Key& key) {
+  if constexpr (std::is_floating_point_v<T>) {
+    // only integral values within the range of keys can be keys
+    if ( !( index >= (T)std::numeric_limits<Key>::min() && index < -(T)std::numeric_limits<Key>::min() ) ) {
+      return false;
+    }
+  }
+  key = (Key)index;
+  return (T)key == index;
+}
+
+template <typename T>
+inline std::optional<T> Collection<T>::find(const T& index) const {
+  if ( provider ) {
+    return provider->element(index);
+  }
+  if ( slots.empty() ) {
+    auto position = (size_t)index - 1;
+    return position < values.size() ? std::optional<T>(values[position]) : std::nullopt;
+  }
+  Key key;
+  if ( !toKey(index,key) ) {
+    return std::nullopt;
+  }
+  for ( size_t i = getSlot(key); slots[i].occupied; i = ( i + 1 ) & ( slots.size() - 1 ) ) {
+    if ( slots[i].key == key ) {
+      return slots[i].value;
+    }
+  }
+  return std::nullopt;
+}
+
+template <typename T>
+inline T Collection<T>::at(const T& index) const {
+  auto value = find(index);
+  if ( !value.has_value() ) {
+    throw std::runtime_error("LIMEX: Illegal index for collection");
+  }
+  return value.value();
+}
+
+template <typename T>
+inline void Collection<T>::prefetch([[maybe_unused]] const T& index) const {
+#if defined(__GNUC__) || defined(__clang__)
+  Key key;
+  if ( !slots.empty() && toKey(index,key) ) {
+    __builtin_prefetch(&slots[getSlot(key)]);
+  }
+#endif
+}
+
 /*******************************
  ** Node
  *******************************/
 
+template <typename T, typename C>
+inline const std::vector<T>& Node<T,C>::getValues( const C& collection, [[maybe_unused]] std::vector<T>& buffer ) {
+  if constexpr (std::is_same_v< C, Collection<T> >) {
+    return collection.getValues(buffer);
+  }
+  else {
+    Budget::charge(collection.size());
+    return collection;
+  }
+}
+
 template <typename T, typename C>
 Node<T,C>::Node(Expression<T,C>* expression, double value)
 : expression(expression), type(Type::literal)
@@ -370,10 +1282,10 @@ Node<T,C>::Node(Expression<T,C>* expression, Type type, std::string name)
 : expression(expression), type(type)
 {
   if ( type == Type::variable ) {
-    operands.emplace_back(expression->getIndex(expression->variables,name));
+    operands.emplace_back(expression->getIndex(expression->getVariableNames(),name));
   }
   else if ( type == Type::collection ) {
-    operands.emplace_back(expression->getIndex(expression->collections,name));
+    operands.emplace_back(expression->getIndex(expression->getCollectionNames(),name));
   }
   else {
     throw std::logic_error("LIMEX: Unexpected node type");
@@ -382,31 +1294,93 @@ Node<T,C>::Node(Expression<T,C>* expression, Type type, std::string name)
 
 template <typename T, typename C>
 Node<T,C>::Node(Expression<T,C>* expression, Type type, std::vector< std::variant< double, size_t, Node<T,C> > > operands)
-: expression(expression), type(type), operands(std::move(operands)) {}
+: expression(expression), type(type), operands(std::move(operands)) 
+{
+  // codes of strings are only meaningful when compared for equality
+  bool membership = ( type == Type::element_of || type == Type::not_element_of );
+  for ( size_t i = 0; i < this->operands.size(); i++ ) {
+    if ( !std::holds_alternative<Node>(this->operands[i]) || !std::get<Node>(this->operands[i]).quoted ) {
+      continue;
+    }
+    auto& operand = std::get<Node>(this->operands[i]);
+    bool permitted = ( operand.type == Type::set ) ? 
+      ( membership && i == 1 ) : 
+      ( membership || type == Type::equal_to || type == Type::not_equal_to || type == Type::set );
+    if ( !permitted ) {
+      throw std::logic_error("LIMEX: String literals can only be compared by ==, !=, ∈, or ∉");
+    }
+  }
+  updateAwaitable();
+}
 
 template <typename T, typename C>
-template <typename U>
-Node<T,C>::Node(Expression<T,C>* expression, const Node<U>& other)
+template <typename U, typename D>
+Node<T,C>::Node(Expression<T,C>* expression, const Node<U,D>& other, const std::function<size_t(size_t)>& callable)
 : expression(expression), type(other.type) 
 {
-  operands.reserve(other.operands.size());
-  for (const auto& operand : other.operands) {
-    if (std::holds_alternative<double>(operand)) {
+  operands.reserve(other.operands.size() + 1);
+  for ( size_t i = 0; i < other.operands.size(); i++ ) {
+    const auto& operand = other.operands[i];
+    if (std::holds_alternative<double>(operand) && other.quoted) {
+      // codes of strings differ between handles
+      operands.emplace_back( (double)expression->handle.intern( other.expression->handle.getString( (size_t)std::get<double>(operand) ) ) );
+      quoted = true;
+    }
+    else if (std::holds_alternative<double>(operand)) {
       operands.emplace_back(std::get<double>(operand));
     }
     else if (std::holds_alternative<size_t>(operand)) {
-      operands.emplace_back(std::get<size_t>(operand));
+      if ( i == 0 && ( type == Type::function_call || type == Type::aggregation ) ) {
+        operands.emplace_back(callable(std::get<size_t>(operand)));
+      }
+      else {
+        operands.emplace_back(std::get<size_t>(operand));
+      }
+    }
+    else {
+      operands.emplace_back(Node(expression, std::get< Node<U,D> >(operand), callable));
+    }
+  }
+
+  // adjust indexed access to collection type
+  if constexpr ( std::is_same_v< C, T > ) {
+    if ( type == Type::index ) {
+      // x[i] becomes at(x,i)
+      auto collection = std::get<size_t>(operands[0]);
+      type = Type::function_call;
+      operands[0] = expression->handle.getIndex("at");
+      operands.insert(operands.begin() + 1, Node(expression, Type::collection, std::vector< std::variant<double, size_t, Node> >{ collection }));
     }
-    else if (std::holds_alternative< Node<U> >(operand)) {
-      const auto& other_node = std::get< Node<U> >(operand);
-      operands.emplace_back(other_node);
+  }
+  else if constexpr ( std::is_same_v< C, std::vector<T> > || std::is_same_v< C, Collection<T> > ) {
+    if ( 
+      type == Type::function_call && 
+      expression->handle.getName(std::get<size_t>(operands[0])) == "at" && 
+      operands.size() == 3 && 
+      std::get<Node>(operands[1]).type == Type::collection 
+    ) {
+      // at(x,i) becomes x[i]
+      auto collection = std::get<size_t>(std::get<Node>(operands[1]).operands[0]);
+      type = Type::index;
+      operands.erase(operands.begin() + 1);
+      operands[0] = collection;
     }
   }
+  updateAwaitable();
+
+  if ( 
+    ( type == Type::function_call || type == Type::aggregation ) && 
+    !( operands.size() == 2 && std::get<Node>(operands[1]).type == Type::collection )
+  ) {
+    // validate number of explicitly given arguments
+    expression->handle.validate( std::get<size_t>(operands[0]), operands.size() - 1 );
+  }
 }
 
 template <typename T, typename C>
 inline T Node<T,C>::evaluate( const std::vector<T>& variableValues, const std::vector<C>& collectionValues) const {
 //std::cerr << "Type: "<< typeName[(int)type] << std::endl;
+  Budget::charge();
   switch (type) {
     case Type::group:
       return std::get<Node>(operands[0]).evaluate(variableValues,collectionValues);
@@ -417,7 +1391,11 @@ inline T Node<T,C>::evaluate( const std::vector<T>& variableValues, const std::v
     case Type::literal:
       return std::get<double>(operands[0]);
     case Type::variable: {
-      return variableValues[std::get<size_t>(operands[0])];
+      auto variable = std::get<size_t>(operands[0]);
+      if ( variable >= variableValues.size() ) {
+        throw std::runtime_error("LIMEX: Insufficient variable values provided");
+      }
+      return variableValues[variable];
     }
     case Type::collection: {
       throw std::runtime_error("LIMEX: Collections cannot be evaluated");
@@ -481,7 +1459,7 @@ inline T Node<T,C>::evaluate( const std::vector<T>& variableValues, const std::v
     }
     case Type::exponentiate: {
       auto index = (size_t)Expression<T,C>::BUILTIN::POW;
-      if ( index >= expression->handle.getNames().size()) {
+      if ( index >= expression->handle.size()) {
         throw std::runtime_error("LIMEX: Callable index out of range");
       }
       // Collect all evaluated arguments
@@ -492,22 +1470,25 @@ inline T Node<T,C>::evaluate( const std::vector<T>& variableValues, const std::v
         );
       }
       // Call the custom callable
-      return expression->handle.implementations[index](arguments);
+      return expression->handle.call(index,arguments);
     }
     case Type::function_call: 
     case Type::aggregation: 
     {
       size_t index = std::get<size_t>(operands[0]);
-      if (index >= expression->handle.getNames().size()) {
+      if (index >= expression->handle.size()) {
         throw std::runtime_error("LIMEX: Callable index out of range");
       }
       if ( index == (size_t)Expression<T,C>::BUILTIN::AT ) {
-        if constexpr (std::is_same_v< C, std::vector<T> >) {
+        if constexpr (std::is_same_v< C, std::vector<T> > || std::is_same_v< C, Collection<T> >) {
           throw std::logic_error("LIMEX: unexpected use of built-in 'at' for double");
         }
         else if constexpr (std::is_same_v< C, T >) {
           // custom index operation
           auto& collection = std::get<size_t>( std::get<Node>(operands[1]).operands[0] );
+          if (collection >= collectionValues.size()) {
+            throw std::runtime_error("LIMEX: Insufficient collections provided");
+          }
           auto collectionIndex = std::get<Node>(operands[2]).evaluate(variableValues,collectionValues);
           return expression->handle.indexedEvaluation( collectionValues[collection], collectionIndex );
         }
@@ -522,14 +1503,23 @@ inline T Node<T,C>::evaluate( const std::vector<T>& variableValues, const std::v
       ) {
         // argument is a collection
         auto collection = std::get<size_t>(std::get<Node>(operands[1]).operands[0]);
-        
-        if constexpr (std::is_same_v< C, std::vector<T> >) {
-          // collection type C is vector<T>
-          return expression->handle.implementations[index](collectionValues[collection]);
+        if (collection >= collectionValues.size()) {
+          throw std::runtime_error("LIMEX: Insufficient collections provided");
+        }
+        if constexpr (std::is_same_v< C, std::vector<T> > || std::is_same_v< C, Collection<T> >) {
+          // collection type C is vector<T> or Collection<T>, values are fetched once as the size of provided collections may require fetching them
+          std::vector<T> buffer;
+          auto& values = getValues(collectionValues[collection],buffer);
+#ifdef LIMEX_METRICS
+          if ( type == Type::aggregation && Metrics::isEnabled() ) {
+            Metrics::recordAggregation(values.size());
+          }
+#endif
+          return expression->handle.call(index,values);
         }
         else if constexpr (std::is_same_v< C, T >) {
           // collection type C is T
-          return expression->handle.aggregateEvaluation( expression->handle.getNames()[index], collectionValues[collection] );
+          return expression->handle.aggregateEvaluation( expression->handle.getName(index), collectionValues[collection] );
         }
         else {
           static_assert([]{ return false; }(), "LIMEX: unexpected collection type");
@@ -543,8 +1533,13 @@ inline T Node<T,C>::evaluate( const std::vector<T>& variableValues, const std::v
             std::get<Node>(operands[i]).evaluate(variableValues,collectionValues)
           );
         }
+#ifdef LIMEX_METRICS
+        if ( type == Type::aggregation && Metrics::isEnabled() ) {
+          Metrics::recordAggregation(arguments.size());
+        }
+#endif
         // Call the custom callable
-        return expression->handle.implementations[index](arguments);
+        return expression->handle.call(index,arguments);
       }
     }
     case Type::index: 
@@ -573,35 +1568,14 @@ inline T Node<T,C>::evaluate( const std::vector<T>& variableValues, const std::v
         else {
           // index is not given as a literal and has to be determined through evaluation
           auto value = std::get<Node>(operands[1]).evaluate(variableValues,collectionValues); 
-                 
-          if constexpr (std::is_arithmetic_v<T>) {
-            // arithmetic value can be cast to index 
-            auto index = (size_t)value - 1;
-            if (index >= collectionValues[collection].size()) {
-              throw std::runtime_error("LIMEX: Illegal index for collection");
-            }
-            return collectionValues[collection][index];
-          }
-          else if constexpr ( requires { std::declval<T>() == std::declval<T>(); } ) {
-            // operator== is available for T and n-ary if statement can be constructed
-            auto index = (size_t)Expression<T,C>::BUILTIN::N_ARY_IF;
-            if ( index >= expression->handle.getNames().size()) {
-              throw std::runtime_error("LIMEX: Callable index out of range");
-            }
-            // collect arguments for n-ary if statement
-            std::vector<T> arguments;
-            for ( size_t i = 0; i < collectionValues[collection].size(); i++ ) {
-              arguments.emplace_back( value == i+1 );
-              arguments.emplace_back( collectionValues[collection][i] );
-            }
-            arguments.emplace_back( false ); // the else result should never occur
-            return expression->handle.implementations[index](arguments);
-          }
-          else {
-            throw std::logic_error("LIMEX: operator== is undefined");
-          }
+          return element(collectionValues[collection], value);
         }
       }
+      else if constexpr (std::is_same_v< C, Collection<T> >) {
+        // position or key is resolved by the collection
+        auto value = std::get<Node>(operands[1]).evaluate(variableValues,collectionValues); 
+        return collectionValues[collection].at(value);
+      }
       else if constexpr (std::is_same_v< C, T >) {
         throw std::logic_error("LIMEX: unexpected use of built-in 'index' for collection type");
       }
@@ -611,39 +1585,51 @@ inline T Node<T,C>::evaluate( const std::vector<T>& variableValues, const std::v
     }
     case Type::element_of: {
       auto index = (size_t)Expression<T>::BUILTIN::ELEMENT_OF;
-      if ( index >= expression->handle.getNames().size()) {
+      if ( index >= expression->handle.size()) {
         throw std::runtime_error("LIMEX: Callable index out of range");
       }
       // Collect all evaluated arguments
       std::vector<T> arguments = { std::get<Node>(operands[0]).evaluate(variableValues,collectionValues) };
       auto& set = std::get<Node>(operands[1]);
+      arguments.reserve(set.operands.size() + 1);
       for ( auto& element : set.operands ) {
+        // literal elements are stored without nodes
+        if ( std::holds_alternative<double>(element) ) {
+          arguments.push_back( std::get<double>(element) );
+          continue;
+        }
         arguments.push_back(
           std::get<Node>(element).evaluate(variableValues,collectionValues)
         );
       }
       // Call the custom callable
-      return expression->handle.implementations[index](arguments);
+      return expression->handle.call(index,arguments);
     }
     case Type::not_element_of: {
       auto index = (size_t)Expression<T,C>::BUILTIN::NOT_ELEMENT_OF;
-      if ( index >= expression->handle.getNames().size()) {
+      if ( index >= expression->handle.size()) {
         throw std::runtime_error("LIMEX: Callable index out of range");
       }
       // Collect all evaluated arguments
       std::vector<T> arguments = { std::get<Node>(operands[0]).evaluate(variableValues,collectionValues) };
       auto& set = std::get<Node>(operands[1]);
+      arguments.reserve(set.operands.size() + 1);
       for ( auto& element : set.operands ) {
+        // literal elements are stored without nodes
+        if ( std::holds_alternative<double>(element) ) {
+          arguments.push_back( std::get<double>(element) );
+          continue;
+        }
         arguments.push_back(
           std::get<Node>(element).evaluate(variableValues,collectionValues)
         );
       }
       // Call the custom callable
-      return expression->handle.implementations[index](arguments);
+      return expression->handle.call(index,arguments);
     }
     case Type::if_then_else: {
       auto index = (size_t)Expression<T,C>::BUILTIN::IF_THEN_ELSE;
-      if ( index >= expression->handle.getNames().size()) {
+      if ( index >= expression->handle.size()) {
         throw std::runtime_error("LIMEX: Callable index out of range");
       }
       // Collect all evaluated arguments
@@ -654,7 +1640,7 @@ inline T Node<T,C>::evaluate( const std::vector<T>& variableValues, const std::v
         );
       }
       // Call the custom callable
-      return expression->handle.implementations[index](arguments);
+      return expression->handle.call(index,arguments);
     }
     case Type::less_than:
     {
@@ -727,710 +1713,3493 @@ inline T Node<T,C>::evaluate( const std::vector<T>& variableValues, const std::v
 };
 
 template <typename T, typename C>
-inline std::string Node<T,C>::stringify() const {
-  std::string result;
-//  result += " ";
-  result += std::string(typeName[(int)type]) + "( ";
-  for ( auto& operand : operands ) {
-    if (std::holds_alternative<double>(operand)) {
-      result += std::to_string(std::get<double>(operand)) + ", ";
+inline uint64_t Node<T,C>::mix(uint64_t hash, uint64_t value) {
+  // splitmix64 finalizer applied to combined value
+  hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+template <typename T, typename C>
+inline uint64_t Node<T,C>::fingerprint(const std::string& name) {
+  // FNV-1a
+  uint64_t value = 0xcbf29ce484222325ULL;
+  for ( unsigned char c : name ) {
+    value = (value ^ c) * 0x100000001b3ULL;
+  }
+  return value;
+}
+
+template <typename T, typename C>
+inline uint64_t Node<T,C>::hash(uint64_t seed) const {
+  return hash(seed, [&](size_t i) { return std::get<Node>(operands[i]).hash(seed); });
+}
+
+template <typename T, typename C>
+template <typename F>
+inline uint64_t Node<T,C>::hash(uint64_t seed, F&& hashOperand) const {
+  auto hashName = [](uint64_t hash, const std::string& name) { return mix(hash, fingerprint(name)); };
+  uint64_t result = mix(seed, (uint64_t)type);
+  for ( size_t i = 0; i < operands.size(); i++ ) {
+    auto& operand = operands[i];
+    if (std::holds_alternative<double>(operand) && quoted) {
+      // strings are hashed instead of codes which depend on the handle
+      result = hashName(result, expression->handle.getString( (size_t)std::get<double>(operand) ));
+    }
+    else if (std::holds_alternative<double>(operand)) {
+      double value = std::get<double>(operand);
+      uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(double));
+      if ( type == Type::set ) {
+        // literal elements of sets are hashed in the same way as literal nodes
+        result = mix(result, mix(mix(mix(seed, (uint64_t)Type::literal), bits), 1));
+      }
+      else {
+        result = mix(result, bits);
+      }
     }
     else if (std::holds_alternative<size_t>(operand)) {
+      // names are hashed instead of indices which depend on the order of appearance
+      size_t index = std::get<size_t>(operand);
       if ( type == Type::variable ) {
-        result += expression->variables.at(std::get<size_t>(operand)) + ", ";
-      }
-      else if ( type == Type::collection ) {
-        result += expression->collections.at(std::get<size_t>(operand)) + ", ";
+        result = hashName(result, expression->variables.at(index));
       }
-      else if ( type == Type::index ) {
-        result += expression->collections.at(std::get<size_t>(operand)) + ", ";
+      else if ( type == Type::collection || type == Type::index ) {
+        result = hashName(result, expression->collections.at(index));
       }
       else {
-        result += expression->handle.names.at(std::get<size_t>(operand)) + ", ";
+        result = hashName(result, expression->handle.getName(index));
       }
     }
-    else if (std::holds_alternative< Node<T,C> >(operand)) {
-      result += std::get<Node<T,C>>(operand).stringify() + ", ";
+    else {
+      result = mix(result, hashOperand(i));
     }
   }
-  result.pop_back(); // remove trailing ' '
-  result.back() = ' '; // replace trailing ',' with ' '
-  result += ")";
-  return result;
+  return mix(result, operands.size());
 }
 
-/*******************************
- ** Expression
- *******************************/
-
 template <typename T, typename C>
-Expression<T,C>::Expression(const std::string& expression, const Handle<T,C>& handle)
-  : input(expression)
-  , handle(handle) 
-  , root(parse()) 
-{
+inline void Node<T,C>::canonicalize() {
+  canonicalize(false);
 }
 
 template <typename T, typename C>
-inline T Expression<T,C>::evaluate( const std::vector<T>& variableValues, const std::vector<C>& collectionValues) const {
-  return root.evaluate(variableValues,collectionValues);
+inline uint64_t Node<T,C>::canonicalize(bool unordered) {
+  // hashes of operands are determined once, so that reordering does not rehash subtrees
+  std::vector<uint64_t> hashes(operands.size(), 0);
+  for ( size_t i = 0; i < operands.size(); i++ ) {
+    auto& operand = operands[i];
+    if ( std::holds_alternative<Node>(operand) ) {
+      while ( std::get<Node>(operand).type == Type::group && std::get<Node>(operand).operands.size() == 1 && std::holds_alternative<Node>(std::get<Node>(operand).operands[0]) ) {
+        // remove redundant group
+        Node child = std::move(std::get<Node>(std::get<Node>(operand).operands[0]));
+        operand = std::move(child);
+      }
+      // elements of a set can be reordered if the set is only used for membership tests
+      hashes[i] = std::get<Node>(operand).canonicalize( i == 1 && (type == Type::element_of || type == Type::not_element_of) );
+    }
+    else if ( std::holds_alternative<double>(operand) && quoted ) {
+      // codes of strings depend on the handle
+      hashes[i] = fingerprint( expression->handle.getString( (size_t)std::get<double>(operand) ) );
+    }
+    else if ( std::holds_alternative<double>(operand) ) {
+      hashes[i] = Node(nullptr, std::get<double>(operand)).hash();
+    }
+  }
+
+  auto order = [&](size_t lhs, size_t rhs) {
+    if ( hashes[rhs] < hashes[lhs] ) {
+      std::swap(operands[lhs],operands[rhs]);
+      std::swap(hashes[lhs],hashes[rhs]);
+    }
+  };
+  auto sort = [&](size_t begin) {
+    std::vector< std::pair<uint64_t, std::variant<double, size_t, Node>> > elements;
+    for ( size_t i = begin; i < operands.size(); i++ ) {
+      elements.emplace_back( hashes[i], std::move(operands[i]) );
+    }
+    std::stable_sort(elements.begin(), elements.end(), [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
+    for ( size_t i = begin; i < operands.size(); i++ ) {
+      hashes[i] = elements[i - begin].first;
+      operands[i] = std::move(elements[i - begin].second);
+    }
+  };
+
+  switch (type) {
+    case Type::negate: {
+      auto& node = std::get<Node>(operands[0]);
+      if ( node.type == Type::literal ) {
+        // negated literal becomes negative literal, negating 0 gives -0
+        double value = -std::get<double>(node.operands[0]);
+        type = Type::literal;
+        operands = { value };
+        hashes = { 0 };
+      }
+      break;
+    }
+    case Type::greater_than:
+      type = Type::less_than;
+      std::swap(operands[0],operands[1]);
+      std::swap(hashes[0],hashes[1]);
+      break;
+    case Type::greater_or_equal:
+      type = Type::less_or_equal;
+      std::swap(operands[0],operands[1]);
+      std::swap(hashes[0],hashes[1]);
+      break;
+    case Type::add:
+    case Type::multiply:
+    case Type::logical_and:
+    case Type::logical_or:
+    case Type::equal_to:
+    case Type::not_equal_to:
+      order(0,1);
+      break;
+    case Type::set:
+      if ( unordered ) {
+        sort(0);
+      }
+      break;
+    case Type::function_call:
+    case Type::aggregation: {
+      size_t index = std::get<size_t>(operands[0]);
+      bool explicitArguments = true;
+      for ( size_t i = 1; i < operands.size(); i++ ) {
+        explicitArguments = explicitArguments && std::get<Node>(operands[i]).type != Type::collection;
+      }
+      if ( explicitArguments && index < expression->handle.size() && expression->handle.getDescriptor(index).exactlyCommutative ) {
+        sort(1);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return hash(0, [&](size_t i) { return hashes[i]; });
 }
 
 template <typename T, typename C>
-inline Node<T,C> Expression<T,C>::parse() {
-  auto rootToken = tokenize(input);
-//std::cerr << rootToken.stringify() << std::endl;
-  return buildTree( Type::group, rootToken.children, std::nullopt );
+inline T Node<T,C>::element( const C& collection, const T& value ) const {
+  if constexpr (std::is_arithmetic_v<T>) {
+    // arithmetic value can be cast to index 
+    auto index = (size_t)value - 1;
+    if (index >= collection.size()) {
+      throw std::runtime_error("LIMEX: Illegal index for collection");
+    }
+    return collection[index];
+  }
+  else if constexpr ( requires { std::declval<T>() == std::declval<T>(); } ) {
+    // operator== is available for T and n-ary if statement can be constructed
+    auto index = (size_t)Expression<T,C>::BUILTIN::N_ARY_IF;
+    if ( index >= expression->handle.size()) {
+      throw std::runtime_error("LIMEX: Callable index out of range");
+    }
+    // collect arguments for n-ary if statement
+    std::vector<T> arguments;
+    for ( size_t i = 0; i < collection.size(); i++ ) {
+      arguments.emplace_back( value == i+1 );
+      arguments.emplace_back( collection[i] );
+    }
+    arguments.emplace_back( false ); // the else result should never occur
+    return expression->handle.call(index,arguments);
+  }
+  else {
+    throw std::logic_error("LIMEX: operator== is undefined");
+  }
 }
 
 template <typename T, typename C>
-inline Token Expression<T,C>::tokenize(const std::string& input) {
-  Token root = Token( Token::Category::OPERAND, Token::Type::GROUP, "" );
-  std::stack< std::pair<Token*,std::string_view> > groupStack;
-  groupStack.emplace(&root,"#");
-  size_t pos = 0;
-  Token::Category expected = Token::Category::PREFIX;
+inline void Node<T,C>::updateAwaitable() {
+  // operands are constructed before the node, so that only their flags need to be checked
+  awaitable = ( 
+    expression && 
+    (type == Type::function_call || type == Type::aggregation) && 
+    expression->handle.isAwaitable(std::get<size_t>(operands[0])) 
+  );
+  for ( auto& operand : operands ) {
+    if ( std::holds_alternative<Node>(operand) && std::get<Node>(operand).awaitable ) {
+      awaitable = true;
+    }
+  }
+}
 
-  while (pos < input.length()) {
-    skipWhitespaces(input,pos);
-    if ( pos == input.length() ) break; 
+template <typename T, typename C>
+inline void Node<T,C>::rebind(Expression<T,C>* expression) {
+  this->expression = expression;
+  for ( auto& operand : operands ) {
+    if ( std::holds_alternative<Node>(operand) ) {
+      std::get<Node>(operand).rebind(expression);
+    }
+  }
+}
 
-    if ( expected == Token::Category::PREFIX ) {
-      // Consume prefix
-      std::string match = fetch(input, pos, prefix);
-      if ( !match.empty() ) {
-        pos += match.size();
-        if ( pos == input.length() ) {
-          throw std::runtime_error("LIMEX: Prefix operator must be followed by operand: " + input.substr(0,pos));
-        }; 
-        groupStack.top().first->children.emplace_back(Token::Category::PREFIX, Token::Type::OPERATOR, std::move(match));
+template <typename T, typename C>
+inline void Node<T,C>::specialize( const std::vector< std::optional<T> >& constants ) {
+  if constexpr (std::is_arithmetic_v<T>) {
+    if ( type == Type::variable ) {
+      auto index = std::get<size_t>(operands[0]);
+      if ( index < constants.size() && constants[index].has_value() ) {
+        type = Type::literal;
+        operands = { (double)constants[index].value() };
       }
-      expected = Token::Category::OPERAND;
+      return;
+    }
+    for ( auto& operand : operands ) {
+      if ( std::holds_alternative<Node>(operand) ) {
+        std::get<Node>(operand).specialize(constants);
+      }
+    }
+    auto isLiteral = [](const std::variant<double, size_t, Node>& operand) {
+      return std::holds_alternative<Node>(operand) && std::get<Node>(operand).type == Type::literal;
+    };
+    auto isConstant = [&isLiteral](const std::variant<double, size_t, Node>& element) {
+      return std::holds_alternative<double>(element) || isLiteral(element);
+    };
+    auto isTrivial = [](const Node* node) {
+      while ( node->type == Type::group ) {
+        node = &std::get<Node>(node->operands[0]);
+      }
+      return node->type == Type::literal || node->type == Type::variable;
+    };
+    if ( type == Type::if_then_else && isLiteral(operands[0]) ) {
+      size_t taken = std::get<double>(std::get<Node>(operands[0]).operands[0]) ? 1 : 2;
+      // eliminate branch that cannot be taken unless its evaluation may throw or have side effects
+      if ( isTrivial( &std::get<Node>(operands[3 - taken]) ) ) {
+        Node branch = std::move(std::get<Node>(operands[taken]));
+        *this = std::move(branch);
+      }
+      return;
+    }
+    if ( 
+      type == Type::literal || type == Type::variable || type == Type::collection || 
+      type == Type::set || type == Type::sequence || type == Type::index || 
+      (int)type >= (int)Type::assign ||
+      !isPure()
+    ) {
+      return;
+    }
+    for ( size_t i = ( type == Type::function_call || type == Type::aggregation ) ? 1 : 0; i < operands.size(); i++ ) {
+      bool constant = isLiteral(operands[i]) || (
+        std::holds_alternative<Node>(operands[i]) &&
+        std::get<Node>(operands[i]).type == Type::set && 
+        std::ranges::all_of(std::get<Node>(operands[i]).operands, isConstant)
+      );
+      if ( !constant ) {
+        return;
+      }
+    }
+    try {
+      double value = (double)evaluate();
+      type = Type::literal;
+      operands = { value };
     }
+    catch (...) {
+      // errors are raised when evaluating the specialized node
+    }
+  }
+}
 
-    if ( expected == Token::Category::OPERAND ) {
-      if ( auto match = fetch(input, pos, keywords); !match.empty() ) {
-//std::cerr << "keywords" << std::endl;
-        pos += match.size();
-        if ( match == "true" ) {
-          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::NUMBER, std::to_string(true));
+template <typename T, typename C>
+inline bool Node<T,C>::isPure() const {
+  auto pure = [this](typename Expression<T,C>::BUILTIN builtin) {
+    return (size_t)builtin < expression->handle.size() && expression->handle.getDescriptor((size_t)builtin).pure;
+  };
+  switch (type) {
+    case Type::function_call:
+    case Type::aggregation: {
+      size_t index = std::get<size_t>(operands[0]);
+      if ( index >= expression->handle.size() || !expression->handle.getDescriptor(index).pure ) return false;
+      break;
+    }
+    case Type::exponentiate:
+      if ( !pure(Expression<T,C>::BUILTIN::POW) ) return false;
+      break;
+    case Type::if_then_else:
+      if ( !pure(Expression<T,C>::BUILTIN::IF_THEN_ELSE) ) return false;
+      break;
+    case Type::element_of:
+      if ( !pure(Expression<T,C>::BUILTIN::ELEMENT_OF) ) return false;
+      break;
+    case Type::not_element_of:
+      if ( !pure(Expression<T,C>::BUILTIN::NOT_ELEMENT_OF) ) return false;
+      break;
+    case Type::index:
+      if ( !std::is_arithmetic_v<T> && !pure(Expression<T,C>::BUILTIN::N_ARY_IF) ) return false;
+      break;
+    default:
+      break;
+  }
+  for ( auto& operand : operands ) {
+    if ( std::holds_alternative<Node>(operand) && !std::get<Node>(operand).isPure() ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T, typename C>
+inline void Node<T,C>::estimateCost( double& constant, std::vector<double>& perElement ) const {
+  using BUILTIN = typename Expression<T,C>::BUILTIN;
+  auto cost = [this](size_t index) {
+    return index < expression->handle.size() ? expression->handle.getDescriptor(index).cost : 1.0;
+  };
+  switch (type) {
+    case Type::literal:
+    case Type::variable:
+    case Type::collection:
+    case Type::group:
+    case Type::set:
+    case Type::sequence:
+    case Type::assign:
+      // values are only loaded or passed on
+      break;
+    case Type::divide:
+    case Type::divide_assign:
+      constant += 4;
+      break;
+    case Type::cube:
+      constant += 2;
+      break;
+    case Type::exponentiate:
+      constant += cost((size_t)BUILTIN::POW);
+      break;
+    case Type::if_then_else:
+      // all branches are evaluated
+      constant += cost((size_t)BUILTIN::IF_THEN_ELSE);
+      break;
+    case Type::element_of:
+    case Type::not_element_of:
+    {
+      // each element of the set is compared
+      auto builtin = ( type == Type::element_of ) ? BUILTIN::ELEMENT_OF : BUILTIN::NOT_ELEMENT_OF;
+      constant += cost((size_t)builtin) * std::get<Node>(operands[1]).operands.size();
+      break;
+    }
+    case Type::function_call:
+    case Type::aggregation:
+    {
+      size_t index = std::get<size_t>(operands[0]);
+      if (
+        index != (size_t)BUILTIN::AT &&
+        operands.size() == 2 && 
+        std::holds_alternative<Node>(operands[1]) &&
+        std::get<Node>(operands[1]).type == Type::collection
+      ) {
+        // the callable is applied to each element of the collection
+        size_t collection = std::get<size_t>(std::get<Node>(operands[1]).operands[0]);
+        perElement.resize( std::max(perElement.size(), collection + 1) );
+        perElement[collection] += cost(index);
+      }
+      else if ( type == Type::aggregation ) {
+        // the callable is applied to each argument
+        constant += cost(index) * ( operands.size() - 1 );
+      }
+      else {
+        constant += cost(index);
+      }
+      break;
+    }
+    case Type::index:
+    {
+      if ( !std::is_arithmetic_v<T> && std::get<Node>(operands[1]).type != Type::literal ) {
+        // n-ary if statement with a condition and a value for each element of the collection
+        size_t collection = std::get<size_t>(operands[0]);
+        perElement.resize( std::max(perElement.size(), collection + 1) );
+        perElement[collection] += 1 + cost((size_t)BUILTIN::N_ARY_IF);
+      }
+      else {
+        constant += 1;
+      }
+      break;
+    }
+    default:
+      constant += 1;
+      break;
+  }
+  for ( auto& operand : operands ) {
+    if ( std::holds_alternative<Node>(operand) ) {
+      std::get<Node>(operand).estimateCost(constant,perElement);
+    }
+  }
+}
+
+template <typename T, typename C>
+inline void Node<T,C>::analyzeAccess( std::vector<bool>& scanned, std::vector<size_t>& points ) const {
+  auto reserve = [&](size_t collection) {
+    if ( collection >= scanned.size() ) {
+      scanned.resize(collection + 1);
+      points.resize(collection + 1);
+    }
+  };
+  if ( type == Type::index ) {
+    size_t collection = std::get<size_t>(operands[0]);
+    reserve(collection);
+    if ( !std::is_arithmetic_v<T> && std::get<Node>(operands[1]).type != Type::literal ) {
+      // n-ary if statement uses all elements
+      scanned[collection] = true;
+    }
+    else {
+      points[collection]++;
+    }
+  }
+  else if ( 
+    ( type == Type::function_call || type == Type::aggregation ) && 
+    operands.size() >= 2 && 
+    std::holds_alternative<Node>(operands[1]) && 
+    std::get<Node>(operands[1]).type == Type::collection
+  ) {
+    size_t collection = std::get<size_t>(std::get<Node>(operands[1]).operands[0]);
+    reserve(collection);
+    if ( std::get<size_t>(operands[0]) == (size_t)Expression<T,C>::BUILTIN::AT ) {
+      // custom index operation
+      points[collection]++;
+    }
+    else {
+      scanned[collection] = true;
+    }
+  }
+  for ( auto& operand : operands ) {
+    if ( std::holds_alternative<Node>(operand) ) {
+      std::get<Node>(operand).analyzeAccess(scanned,points);
+    }
+  }
+}
+
+template <typename T, typename C>
+inline Task<T> Node<T,C>::evaluateAsync( Scheduler<T,C>& scheduler, const std::vector<T>& variableValues, const std::vector<C>& collectionValues) const {
+  if ( !isAwaitable() ) {
+    co_return evaluate(variableValues,collectionValues);
+  }
+  Budget::charge();
+  // evaluate all operand nodes, set elements are evaluated individually
+  std::vector<T> values;
+  for ( auto& operand : operands ) {
+    if ( !std::holds_alternative<Node>(operand) ) continue;
+    auto& node = std::get<Node>(operand);
+    if ( node.type == Type::set ) {
+      for ( auto& element : node.operands ) {
+        if ( std::holds_alternative<double>(element) ) {
+          values.push_back( std::get<double>(element) );
+          continue;
         }
-        else if ( match == "false" ) {
-          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::NUMBER, std::to_string(false));
+        auto task = std::get<Node>(element).evaluateAsync(scheduler,variableValues,collectionValues);
+        T value = co_await task;
+        values.push_back( std::move(value) );
+      }
+    }
+    else if ( node.type != Type::collection ) {
+      auto task = node.evaluateAsync(scheduler,variableValues,collectionValues);
+      T value = co_await task;
+      values.push_back( std::move(value) );
+    }
+  }
+
+  auto& handle = expression->handle;
+  switch (type) {
+    case Type::group:
+    case Type::assign:
+      co_return values[0];
+    case Type::negate:
+      co_return -values[0];
+    case Type::logical_not:
+      co_return !values[0];
+    case Type::square:
+      co_return values[0] * values[0];
+    case Type::cube:
+      co_return values[0] * values[0] * values[0];
+    case Type::logical_and:
+      co_return values[0] && values[1];
+    case Type::logical_or:
+      co_return values[0] || values[1];
+    case Type::add:
+    case Type::add_assign:
+      co_return values[0] + values[1];
+    case Type::subtract:
+    case Type::subtract_assign:
+      co_return values[0] - values[1];
+    case Type::multiply:
+    case Type::multiply_assign:
+      co_return values[0] * values[1];
+    case Type::divide:
+      if constexpr (std::is_arithmetic_v<T>) {
+        if (values[1] == 0) {
+          throw std::runtime_error("LIMEX: Division by zero");
         }
-        expected = Token::Category::INFIX;
-        continue;
       }
-      else if ( startsWith(input,pos,ternary[0]) ) {
-        // ternary keyowrd "if"
-        pos += 2;
-        expected = Token::Category::PREFIX;
-        groupStack.top().first->children.emplace_back(Token::Category::PREFIX, Token::Type::GROUP, std::string(ternary[0]));
-        groupStack.emplace(&groupStack.top().first->children.back(),ternary[1]); // groub closed by "then"
-        continue;
+      co_return values[0] / values[1];
+    case Type::divide_assign:
+      co_return values[0] / values[1];
+    case Type::less_than:
+      co_return values[0] < values[1];
+    case Type::less_or_equal:
+      co_return values[0] <= values[1];
+    case Type::greater_than:
+      co_return values[0] > values[1];
+    case Type::greater_or_equal:
+      co_return values[0] >= values[1];
+    case Type::equal_to:
+      co_return values[0] == values[1];
+    case Type::not_equal_to:
+      co_return values[0] != values[1];
+    case Type::exponentiate:
+      co_return handle.call((size_t)Expression<T,C>::BUILTIN::POW,values);
+    case Type::if_then_else:
+      co_return handle.call((size_t)Expression<T,C>::BUILTIN::IF_THEN_ELSE,values);
+    case Type::element_of:
+      co_return handle.call((size_t)Expression<T,C>::BUILTIN::ELEMENT_OF,values);
+    case Type::not_element_of:
+      co_return handle.call((size_t)Expression<T,C>::BUILTIN::NOT_ELEMENT_OF,values);
+    case Type::index:
+      if constexpr (std::is_same_v< C, std::vector<T> >) {
+        size_t collection = std::get<size_t>(operands[0]);
+        if (collection >= collectionValues.size()) {
+          throw std::runtime_error("LIMEX: Insufficient collections provided");
+        }
+        co_return element(collectionValues[collection], values[0]);
       }
-      else if ( startsWith(input,pos,ternary[1]) || startsWith(input,pos,ternary[2]) ) {
-        // close current group upon then and else
-        expected = Token::Category::INFIX;
+      else if constexpr (std::is_same_v< C, Collection<T> >) {
+        size_t collection = std::get<size_t>(operands[0]);
+        if (collection >= collectionValues.size()) {
+          throw std::runtime_error("LIMEX: Insufficient collections provided");
+        }
+        co_return collectionValues[collection].at(values[0]);
       }
-      else if ( isnumeric( input[pos] ) ) {
-        // Consume numbers
-        std::string number;
-        while (pos < input.length() && isnumeric( input[pos] ) ) {
-          number += input[pos++];
+      else {
+        throw std::logic_error("LIMEX: unexpected use of built-in 'index' for collection type");
+      }
+    case Type::function_call:
+    case Type::aggregation:
+    {
+      size_t index = std::get<size_t>(operands[0]);
+      if ( index == (size_t)Expression<T,C>::BUILTIN::AT ) {
+        if constexpr (std::is_same_v< C, T >) {
+          auto& collection = std::get<size_t>( std::get<Node>(operands[1]).operands[0] );
+          if (collection >= collectionValues.size()) {
+            throw std::runtime_error("LIMEX: Insufficient collections provided");
+          }
+          co_return handle.indexedEvaluation( collectionValues[collection], values[0] );
+        }
+        else {
+          throw std::logic_error("LIMEX: unexpected use of built-in 'at' for double");
         }
-        expected = Token::Category::POSTFIX;
-        groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::NUMBER, number);
       }
-      else if ( isalphanumeric( input[pos] ) ) {
-        // Consume name
-        std::string name;
-        while (pos < input.length() && isalphanumeric( input[pos] ) ) {
-          name += input[pos++];
+      if ( operands.size() == 2 && std::get<Node>(operands[1]).type == Type::collection ) {
+        // argument is a collection
+        if constexpr (std::is_same_v< C, std::vector<T> > || std::is_same_v< C, Collection<T> >) {
+          size_t collection = std::get<size_t>(std::get<Node>(operands[1]).operands[0]);
+          if (collection >= collectionValues.size()) {
+            throw std::runtime_error("LIMEX: Insufficient collections provided");
+          }
+          std::vector<T> buffer;
+          values = getValues(collectionValues[collection],buffer);
         }
-        if ( pos < input.length() && input[pos] == '(' ) {
-          ++pos;
-          expected = Token::Category::PREFIX;
-          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::FUNCTION_CALL, name);
-          groupStack.emplace(&groupStack.top().first->children.back(),")");
-          continue;
+        else {
+          throw std::logic_error("LIMEX: awaitable callables cannot aggregate collections of this type");
         }
-        else if ( startsWith(input,pos,"[]") ) {
-          pos += 2;
-          expected = Token::Category::OPERAND;
-          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::COLLECTION, name);
+      }
+      if ( !handle.isAwaitable(index) ) {
+        co_return handle.call(index,values);
+      }
+      typename Scheduler<T,C>::Call call{ &scheduler, &handle, index, std::move(values), std::nullopt, nullptr, nullptr };
+      T result = co_await call;
+      co_return result;
+    }
+    default:
+      throw std::runtime_error("LIMEX: Unsupported type '" + std::string(typeName[(int)type]) + "'in evaluateAsync");
+  }
+}
+
+template <typename T, typename C>
+inline void Node<T,C>::evaluateBatch( const std::vector< std::vector<T> >& variableColumns, const std::vector<C>& collectionValues, size_t begin, std::span<T> results) const {
+  Budget::charge(results.size());
+  auto binary = [&](auto operation) {
+    std::get<Node>(operands[0]).evaluateBatch(variableColumns,collectionValues,begin,results);
+    std::vector<T> right(results.size());
+    std::get<Node>(operands[1]).evaluateBatch(variableColumns,collectionValues,begin,right);
+    for (size_t i = 0; i < results.size(); i++) {
+      results[i] = operation(results[i],right[i]);
+    }
+  };
+  auto unary = [&](auto operation) {
+    std::get<Node>(operands[0]).evaluateBatch(variableColumns,collectionValues,begin,results);
+    for (size_t i = 0; i < results.size(); i++) {
+      results[i] = operation(results[i]);
+    }
+  };
+
+  if constexpr (std::is_same_v< C, Collection<T> >) {
+    if ( type == Type::index ) {
+      size_t collection = std::get<size_t>(operands[0]);
+      if (collection >= collectionValues.size()) {
+        throw std::runtime_error("LIMEX: Insufficient collections provided");
+      }
+      auto& values = collectionValues[collection];
+      std::get<Node>(operands[1]).evaluateBatch(variableColumns,collectionValues,begin,results);
+      // slots of keyed collections are prefetched a few rows ahead of their lookup
+      constexpr size_t DISTANCE = 8;
+      for ( size_t row = 0; values.isKeyed() && row < std::min(DISTANCE, results.size()); row++ ) {
+        values.prefetch(results[row]);
+      }
+      for ( size_t row = 0; row < results.size(); row++ ) {
+        if ( values.isKeyed() && row + DISTANCE < results.size() ) {
+          values.prefetch(results[row + DISTANCE]);
         }
-        else if ( pos < input.length() && input[pos] == '[' ) {
-          ++pos;
-          expected = Token::Category::PREFIX;
-          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::INDEXED_VARIABLE, name);
-          groupStack.emplace(&groupStack.top().first->children.back(),"]");
-          continue;
+        results[row] = values.at(results[row]);
+      }
+      return;
+    }
+  }
+
+  switch (type) {
+    case Type::literal: {
+      std::fill(results.begin(), results.end(), T(std::get<double>(operands[0])));
+      return;
+    }
+    case Type::variable: {
+      auto variable = std::get<size_t>(operands[0]);
+      if (variable >= variableColumns.size() || variableColumns[variable].size() < begin + results.size()) {
+        throw std::runtime_error("LIMEX: Insufficient variable values provided");
+      }
+      std::copy_n(variableColumns[variable].begin() + begin, results.size(), results.begin());
+      return;
+    }
+    case Type::group:
+    case Type::assign:
+      return std::get<Node>(operands[0]).evaluateBatch(variableColumns,collectionValues,begin,results);
+    case Type::negate:
+      return unary([](const T& value) -> T { return -value; });
+    case Type::logical_not:
+      return unary([](const T& value) -> T { return !value; });
+    case Type::square:
+      return unary([](const T& value) -> T { return value * value; });
+    case Type::cube:
+      return unary([](const T& value) -> T { return value * value * value; });
+    case Type::logical_and:
+      return binary([](const T& left, const T& right) -> T { return left && right; });
+    case Type::logical_or:
+      return binary([](const T& left, const T& right) -> T { return left || right; });
+    case Type::add:
+    case Type::add_assign:
+      return binary([](const T& left, const T& right) -> T { return left + right; });
+    case Type::subtract:
+    case Type::subtract_assign:
+      return binary([](const T& left, const T& right) -> T { return left - right; });
+    case Type::multiply:
+    case Type::multiply_assign:
+      return binary([](const T& left, const T& right) -> T { return left * right; });
+    case Type::divide:
+      return binary([](const T& left, const T& right) -> T {
+        if constexpr (std::is_arithmetic_v<T>) {
+          if (right == 0) {
+            throw std::runtime_error("LIMEX: Division by zero");
+          }
         }
-        else if ( pos < input.length() && input[pos] == '{' ) {
-          ++pos;
-          expected = Token::Category::PREFIX;
-          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::AGGREGATION, name);
-          groupStack.emplace(&groupStack.top().first->children.back(),"}");
-          continue;
+        return left / right;
+      });
+    case Type::divide_assign:
+      return binary([](const T& left, const T& right) -> T { return left / right; });
+    case Type::less_than:
+      return binary([](const T& left, const T& right) -> T { return left < right; });
+    case Type::less_or_equal:
+      return binary([](const T& left, const T& right) -> T { return left <= right; });
+    case Type::greater_than:
+      return binary([](const T& left, const T& right) -> T { return left > right; });
+    case Type::greater_or_equal:
+      return binary([](const T& left, const T& right) -> T { return left >= right; });
+    case Type::equal_to:
+      return binary([](const T& left, const T& right) -> T { return left == right; });
+    case Type::not_equal_to:
+      return binary([](const T& left, const T& right) -> T { return left != right; });
+    case Type::exponentiate:
+    case Type::if_then_else:
+    case Type::function_call:
+    case Type::aggregation:
+    {
+      auto& handle = expression->handle;
+      size_t first = ( type == Type::function_call || type == Type::aggregation );
+      size_t index = 
+        first ? std::get<size_t>(operands[0]) : 
+        type == Type::exponentiate ? (size_t)Expression<T,C>::BUILTIN::POW : 
+        (size_t)Expression<T,C>::BUILTIN::IF_THEN_ELSE;
+      bool explicitArguments = ( index < handle.size() && !( first && index == (size_t)Expression<T,C>::BUILTIN::AT ) );
+      for ( size_t i = first; explicitArguments && i < operands.size(); i++ ) {
+        explicitArguments = ( std::holds_alternative<Node>(operands[i]) && std::get<Node>(operands[i]).type != Type::collection );
+      }
+      if ( explicitArguments ) {
+        // evaluate arguments column by column
+        std::vector< std::vector<T> > columns(operands.size() - first, std::vector<T>(results.size()));
+        for ( size_t i = first; i < operands.size(); i++ ) {
+          std::get<Node>(operands[i]).evaluateBatch(variableColumns,collectionValues,begin,columns[i - first]);
         }
-        else {
-          expected = Token::Category::POSTFIX;
-          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::VARIABLE, name);
+        if ( auto& column = handle.getDescriptor(index).column ) {
+          // call the column-wise callable once for all rows
+          std::vector< std::span<const T> > arguments(columns.begin(), columns.end());
+          return column(arguments,results);
         }
+        std::vector<T> arguments(columns.size());
+        for ( size_t row = 0; row < results.size(); row++ ) {
+          for ( size_t i = 0; i < columns.size(); i++ ) {
+            arguments[i] = columns[i][row];
+          }
+          results[row] = handle.call(index,arguments);
+        }
+        return;
+      }
+      [[fallthrough]];
+    }
+    default: {
+      // evaluate row by row
+      std::vector<T> variableValues(variableColumns.size());
+      for (size_t i = 0; i < results.size(); i++) {
+        for (size_t variable = 0; variable < variableColumns.size(); variable++) {
+          if (variableColumns[variable].size() <= begin + i) {
+            throw std::runtime_error("LIMEX: Insufficient variable values provided");
+          }
+          variableValues[variable] = variableColumns[variable][begin + i];
+        }
+        results[i] = evaluate(variableValues,collectionValues);
+      }
+    }
+  }
+}
+
+template <typename T, typename C>
+inline std::string Node<T,C>::stringify() const {
+  std::string result;
+  serialize(result, Notation::AST);
+  return result;
+}
+
+template <typename T, typename C>
+inline bool Node<T,C>::pack( std::vector< std::variant<double, size_t, Node> >& operands ) {
+  // the set is marked as holding codes, so that all values must be codes
+  bool strings = false;
+  bool numbers = false;
+  for ( auto& operand : operands ) {
+    if ( std::holds_alternative<Node>(operand) && std::get<Node>(operand).type == Type::literal ) {
+      ( std::get<Node>(operand).quoted ? strings : numbers ) = true;
+      double value = std::get<double>(std::get<Node>(operand).operands[0]);
+      operand = value;
+    }
+  }
+  if ( strings && numbers ) {
+    throw std::logic_error("LIMEX: Sets cannot mix string and numeric literals");
+  }
+  return strings;
+}
+
+template <typename T, typename C>
+inline std::string Node<T,C>::quote( const std::string& string ) {
+  std::string result = "\"";
+  for ( char c : string ) {
+    if ( c == '"' || c == '\\' ) {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result + "\"";
+}
+
+template <typename T, typename C>
+inline void Node<T,C>::serialize( std::string& buffer, Notation notation ) const {
+  // items are processed from an explicit stack to support deep trees
+  struct Item { 
+    const Node* node = nullptr; 
+    const double* number = nullptr; 
+    std::string_view text = {}; 
+  };
+  std::vector<Item> stack = { Item{ .node = this } };
+  std::vector<Item> sequence; // items of the current node in order of output
+  std::list<std::string> strings; // quoted strings referred to by items
+  char digits[512];
+
+  auto writeNumber = [&](double value) {
+    if ( notation == Notation::INFIX && !std::isfinite(value) ) {
+      // no literal or division by a literal gives the value without raising an error when parsed
+      throw std::logic_error("LIMEX: Non-finite literal cannot be serialized in infix notation");
+    }
+    auto result = ( notation == Notation::INFIX ) ? 
+      std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed) : 
+      std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, result.ptr);
+  };
+
+  // ranks of atoms, postfix, and prefix operators are below ranks of infix and ternary operators
+  auto rank = [](const Node& node) -> unsigned int {
+    switch ( node.type ) {
+      case Type::literal:
+        return std::signbit(std::get<double>(node.operands[0])) ? 2 : 0;
+      case Type::square:
+      case Type::cube:
+        return 1;
+      case Type::negate:
+      case Type::logical_not:
+        return 2;
+      case Type::if_then_else:
+        return 10 + precedences.at(Type::_else);
+      default:
+        return precedences.contains(node.type) && node.type != Type::group && (int)node.type >= (int)Type::logical_and ? 10 + precedences.at(node.type) : 0;
+    }
+  };
+  auto add = [&](const Node& node, bool parenthesize) {
+    if ( parenthesize ) sequence.push_back( Item{ .text = "(" } );
+    sequence.push_back( Item{ .node = &node } );
+    if ( parenthesize ) sequence.push_back( Item{ .text = ")" } );
+  };
+
+  while ( !stack.empty() ) {
+    Item item = stack.back();
+    stack.pop_back();
+    if ( item.number ) {
+      writeNumber(*item.number);
+      continue;
+    }
+    if ( !item.node ) {
+      buffer += item.text;
+      continue;
+    }
+    const Node& node = *item.node;
+    auto& names = node.expression->variables;
+    auto& collections = node.expression->collections;
+    sequence.clear();
+    auto list = [&](size_t first, std::string_view open, std::string_view close) {
+      sequence.push_back( Item{ .text = open } );
+      for ( size_t i = first; i < node.operands.size(); i++ ) {
+        if ( i > first ) sequence.push_back( Item{ .text = ", " } );
+        if ( std::holds_alternative<double>(node.operands[i]) && node.quoted ) {
+          sequence.push_back( Item{ .text = strings.emplace_back( quote( node.expression->handle.getString( (size_t)std::get<double>(node.operands[i]) ) ) ) } );
+        }
+        else if ( std::holds_alternative<double>(node.operands[i]) ) {
+          sequence.push_back( Item{ .number = &std::get<double>(node.operands[i]) } );
+        }
+        else {
+          sequence.push_back( Item{ .node = &std::get<Node>(node.operands[i]) } );
+        }
+      }
+      sequence.push_back( Item{ .text = close } );
+    };
+
+    if ( notation == Notation::AST ) {
+      sequence.push_back( Item{ .text = typeName[(int)node.type] } );
+      sequence.push_back( Item{ .text = "( " } );
+      for ( size_t i = 0; i < node.operands.size(); i++ ) {
+        if ( i > 0 ) sequence.push_back( Item{ .text = ", " } );
+        auto& operand = node.operands[i];
+        if ( std::holds_alternative<double>(operand) && node.quoted ) {
+          sequence.push_back( Item{ .text = strings.emplace_back( quote( node.expression->handle.getString( (size_t)std::get<double>(operand) ) ) ) } );
+        }
+        else if ( std::holds_alternative<double>(operand) ) {
+          sequence.push_back( Item{ .number = &std::get<double>(operand) } );
+        }
+        else if ( std::holds_alternative<size_t>(operand) ) {
+          auto index = std::get<size_t>(operand);
+          if ( node.type == Type::variable ) {
+            sequence.push_back( Item{ .text = names.at(index) } );
+          }
+          else if ( node.type == Type::collection || node.type == Type::index ) {
+            sequence.push_back( Item{ .text = collections.at(index) } );
+          }
+          else {
+            sequence.push_back( Item{ .text = node.expression->handle.getName(index) } );
+          }
+        }
+        else {
+          sequence.push_back( Item{ .node = &std::get<Node>(operand) } );
+        }
+      }
+      sequence.push_back( Item{ .text = " )" } );
+    }
+    else {
+      switch ( node.type ) {
+        case Type::literal:
+          if ( node.quoted ) {
+            sequence.push_back( Item{ .text = strings.emplace_back( quote( node.expression->handle.getString( (size_t)std::get<double>(node.operands[0]) ) ) ) } );
+            break;
+          }
+          sequence.push_back( Item{ .number = &std::get<double>(node.operands[0]) } );
+          break;
+        case Type::variable:
+          sequence.push_back( Item{ .text = names.at(std::get<size_t>(node.operands[0])) } );
+          break;
+        case Type::collection:
+          sequence.push_back( Item{ .text = collections.at(std::get<size_t>(node.operands[0])) } );
+          sequence.push_back( Item{ .text = "[]" } );
+          break;
+        case Type::group:
+          list(0, "(", ")");
+          break;
+        case Type::set:
+          list(0, "{", "}");
+          break;
+        case Type::sequence:
+          list(0, "[", "]");
+          break;
+        case Type::function_call:
+        {
+          auto& name = node.expression->handle.getName(std::get<size_t>(node.operands[0]));
+          if ( 
+            name == "at" && node.operands.size() == 3 && 
+            std::get<Node>(node.operands[1]).type == Type::collection 
+          ) {
+            // indexed access for scalar collection types
+            sequence.push_back( Item{ .text = collections.at(std::get<size_t>(std::get<Node>(node.operands[1]).operands[0])) } );
+            list(2, "[", "]");
+            break;
+          }
+          sequence.push_back( Item{ .text = name } );
+          list(1, "(", ")");
+          break;
+        }
+        case Type::aggregation:
+          sequence.push_back( Item{ .text = node.expression->handle.getName(std::get<size_t>(node.operands[0])) } );
+          list(1, "{", "}");
+          break;
+        case Type::index:
+          sequence.push_back( Item{ .text = collections.at(std::get<size_t>(node.operands[0])) } );
+          list(1, "[", "]");
+          break;
+        case Type::negate:
+        case Type::logical_not:
+          sequence.push_back( Item{ .text = node.type == Type::negate ? "-" : "!" } );
+          add( std::get<Node>(node.operands[0]), rank(std::get<Node>(node.operands[0])) > 1 );
+          break;
+        case Type::square:
+        case Type::cube:
+          add( std::get<Node>(node.operands[0]), rank(std::get<Node>(node.operands[0])) > 0 );
+          sequence.push_back( Item{ .text = node.type == Type::square ? "²" : "³" } );
+          break;
+        case Type::if_then_else:
+        {
+          // the condition only extends to the preceding operand and the alternative ends before comparisons
+          unsigned int ternary = rank(node);
+          add( std::get<Node>(node.operands[0]), rank(std::get<Node>(node.operands[0])) >= 10 );
+          sequence.push_back( Item{ .text = " ? " } );
+          // the parser encloses the consequence in a group
+          auto& consequence = std::get<Node>(node.operands[1]);
+          if ( consequence.type == Type::group && consequence.operands.size() == 1 ) {
+            add( std::get<Node>(consequence.operands[0]), std::get<Node>(consequence.operands[0]).type == Type::if_then_else );
+          }
+          else {
+            add( consequence, rank(consequence) >= ternary );
+          }
+          sequence.push_back( Item{ .text = " : " } );
+          add( std::get<Node>(node.operands[2]), rank(std::get<Node>(node.operands[2])) > ternary );
+          break;
+        }
+        case Type::assign:
+          sequence.push_back( Item{ .text = node.expression->target.value() } );
+          sequence.push_back( Item{ .text = " := " } );
+          add( std::get<Node>(node.operands[0]), false );
+          break;
+        default:
+        {
+          // infix operators
+          static const std::unordered_map<Type, std::string_view> symbols = {
+            {Type::logical_and, " && "}, {Type::logical_or, " || "},
+            {Type::add, " + "}, {Type::subtract, " - "}, {Type::multiply, " * "}, {Type::divide, " / "}, {Type::exponentiate, "^"},
+            {Type::less_than, " < "}, {Type::less_or_equal, " <= "}, {Type::greater_than, " > "}, {Type::greater_or_equal, " >= "},
+            {Type::equal_to, " == "}, {Type::not_equal_to, " != "}, {Type::element_of, " ∈ "}, {Type::not_element_of, " ∉ "},
+            {Type::add_assign, " += "}, {Type::subtract_assign, " -= "}, {Type::multiply_assign, " *= "}, {Type::divide_assign, " /= "}
+          };
+          auto symbol = symbols.find(node.type);
+          if ( symbol == symbols.end() ) {
+            throw std::logic_error("LIMEX: Unsupported type '" + std::string(typeName[(int)node.type]) + "' in serialize");
+          }
+          unsigned int infix = rank(node);
+          auto& left = std::get<Node>(node.operands[0]);
+          auto& right = std::get<Node>(node.operands[1]);
+          // operators are left associative and ternary operands are always enclosed
+          add( left, left.type == Type::if_then_else || rank(left) > infix );
+          sequence.push_back( Item{ .text = symbol->second } );
+          add( right, right.type == Type::if_then_else || rank(right) >= infix );
+          break;
+        }
+      }
+    }
+    stack.insert(stack.end(), sequence.rbegin(), sequence.rend());
+  }
+}
+
+/*******************************
+ ** Expression
+ *******************************/
+
+template <typename T, typename C>
+Expression<T,C>::Expression(const std::string& expression, const Handle<T,C>& handle, PARSING parsing)
+  : input(expression)
+  , handle(handle) 
+  , lazy(parsing == PARSING::LAZY)
+  , root(lazy ? scan() : parse()) 
+{
+}
+
+template <typename T, typename C>
+Expression<T,C>::Expression(const Handle<T,C>& handle, std::vector<std::string> variables, std::vector<std::string> collections, std::optional<std::string> target, const std::function<Node<T,C>(Expression<T,C>*)>& build)
+  : handle(handle) 
+  , variables(std::move(variables))
+  , collections(std::move(collections))
+  , target(std::move(target))
+  , lazy(false)
+  , root(build(this)) 
+{
+}
+
+template <typename T, typename C>
+template <typename U, typename D>
+Expression<T,C>::Expression(const Expression<U,D>& other, const Handle<T,C>& handle)
+  : input(other.input)
+  , handle(handle) 
+  , variables(other.variables)
+  , collections(other.collections)
+  , target(other.target)
+  , lazy(false)
+  , root(this, other.getRoot(), [&, indices = std::vector<std::optional<size_t>>(other.handle.size())](size_t index) mutable {
+      // callables are looked up by name once
+      if ( !indices[index].has_value() ) {
+        indices[index] = handle.getIndex(other.handle.getName(index));
+      }
+      return indices[index].value();
+    }) 
+{
+}
+
+template <typename T, typename C>
+Expression<T,C>::Expression(Expression<T,C>&& other) noexcept
+  : input(other.input)
+  , handle(other.handle) 
+  , variables(std::move(other.variables))
+  , collections(std::move(other.collections))
+  , target(std::move(other.target))
+  , lazy(other.lazy)
+  , built(std::move(other.built))
+  , root(std::move(other.root))
+#ifdef LIMEX_METRICS
+  , structure(other.structure.load())
+#endif
+  , cache(std::move(other.cache))
+  , specialization(std::move(other.specialization))
+  , sampler(std::move(other.sampler))
+{
+  // nodes refer to the expression they belong to
+  root.rebind(this);
+  if ( specialization && specialization->root.has_value() ) {
+    specialization->root->rebind(this);
+  }
+}
+
+template <typename T, typename C>
+inline const Node<T,C>& Expression<T,C>::getRoot() const {
+  if ( lazy ) {
+    // build tree upon first use, names are collected separately and must match the names found by the scan
+    if ( !built.done.load(std::memory_order_acquire) ) {
+      std::call_once(built.flag, [this]() {
+        auto self = const_cast<Expression<T,C>*>(this);
+        Names names;
+        self->building = &names;
+        std::optional< Node<T,C> > node;
+        try {
+          node.emplace(self->parse());
+        }
+        catch ( ... ) {
+          self->building = nullptr;
+          throw;
+        }
+        self->building = nullptr;
+        if ( names.variables != variables || names.collections != collections || names.target != target ) {
+          throw std::logic_error("LIMEX: Names of lazily built tree do not match names found by scan");
+        }
+        root = std::move(node.value());
+        built.done.store(true, std::memory_order_release);
+      });
+    }
+  }
+  return root;
+}
+
+template <typename T, typename C>
+inline void Expression<T,C>::canonicalize() {
+  getRoot();
+  root.canonicalize();
+#ifdef LIMEX_METRICS
+  structure.store(0, std::memory_order_relaxed);
+#endif
+}
+
+template <typename T, typename C>
+inline uint64_t Expression<T,C>::hash() const {
+  auto& root = getRoot();
+  // targets are not part of the tree for definitions
+  return target.has_value() ? root.hash(Node<T,C>::fingerprint(target.value())) : root.hash();
+}
+
+template <typename T, typename C>
+inline std::array<uint64_t,2> Expression<T,C>::hash128() const {
+  auto& root = getRoot();
+  uint64_t seed = target.has_value() ? Node<T,C>::fingerprint(target.value()) : 0;
+  return { root.hash(seed), root.hash(seed ^ 0x5bd1e995) };
+}
+
+template <typename T, typename C>
+inline T Expression<T,C>::evaluate( const std::vector<T>& variableValues, const std::vector<C>& collectionValues) const {
+#ifdef LIMEX_METRICS
+  if ( Metrics::isEnabled() ) {
+    return Metrics::measure(*this, [&]() { return evaluateSampled(variableValues,collectionValues); });
+  }
+#endif
+  return evaluateSampled(variableValues,collectionValues);
+}
+
+template <typename T, typename C>
+inline T Expression<T,C>::evaluateSampled( const std::vector<T>& variableValues, const std::vector<C>& collectionValues) const {
+  if ( sampler ) {
+    auto start = std::chrono::steady_clock::now();
+    T result = cache ? evaluateCached(variableValues,collectionValues) : evaluateRoot(variableValues,collectionValues);
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    if ( duration >= sampler->getThreshold() ) {
+      sampler->record(*this, duration, variableValues, collectionValues);
+    }
+    return result;
+  }
+  if ( cache ) {
+    return evaluateCached(variableValues,collectionValues);
+  }
+  return evaluateRoot(variableValues,collectionValues);
+}
+
+template <typename T, typename C>
+inline T Expression<T,C>::evaluateRoot( const std::vector<T>& variableValues, const std::vector<C>& collectionValues) const {
+  if ( specialization ) {
+    if ( !specialization->ready.load(std::memory_order_acquire) ) {
+      observe(variableValues);
+    }
+    else if ( specialization->root ) {
+      bool valid = true;
+      for ( auto& [index, value] : specialization->guards ) {
+        // variables without values are left to the general version
+        if ( index >= variableValues.size() || std::memcmp(&variableValues[index], &value, sizeof(T)) != 0 ) {
+          valid = false;
+          break;
+        }
+      }
+      if ( valid ) {
+        specialization->hits.fetch_add(1, std::memory_order_relaxed);
+        return specialization->root->evaluate(variableValues,collectionValues);
+      }
+      specialization->failures.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  return getRoot().evaluate(variableValues,collectionValues);
+}
+
+template <typename T, typename C>
+inline void Expression<T,C>::enableSpecialization(size_t observations) {
+  if constexpr (std::is_arithmetic_v<T>) {
+    specialization = std::make_unique<Specialization>();
+    specialization->observations = std::max<size_t>(observations, 1);
+  }
+  else {
+    throw std::logic_error("LIMEX: Specialization is only supported for arithmetic types");
+  }
+}
+
+template <typename T, typename C>
+inline void Expression<T,C>::observe( const std::vector<T>& variableValues ) const {
+  std::lock_guard lock(specialization->mutex);
+  if ( specialization->ready.load(std::memory_order_relaxed) || variableValues.size() != variables.size() ) {
+    return;
+  }
+  if ( specialization->observed++ == 0 ) {
+    specialization->constants.assign(variableValues.begin(), variableValues.end());
+  }
+  else {
+    for ( size_t i = 0; i < variableValues.size(); i++ ) {
+      auto& constant = specialization->constants[i];
+      if ( constant.has_value() && std::memcmp(&constant.value(), &variableValues[i], sizeof(T)) != 0 ) {
+        constant.reset();
+      }
+    }
+  }
+  if ( specialization->observed < specialization->observations ) {
+    return;
+  }
+  for ( size_t i = 0; i < specialization->constants.size(); i++ ) {
+    if ( specialization->constants[i].has_value() ) {
+      specialization->guards.emplace_back(i, specialization->constants[i].value());
+    }
+  }
+  if ( !specialization->guards.empty() ) {
+    specialization->root.emplace(getRoot());
+    specialization->root->specialize(specialization->constants);
+  }
+  specialization->ready.store(true, std::memory_order_release);
+}
+
+template <typename T, typename C>
+inline typename Expression<T,C>::SpecializationStatistics Expression<T,C>::getSpecializationStatistics() const {
+  SpecializationStatistics statistics;
+  if ( !specialization || !specialization->ready.load(std::memory_order_acquire) ) return statistics;
+  for ( auto& [index, value] : specialization->guards ) {
+    statistics.constants.push_back(variables[index]);
+  }
+  statistics.hits = specialization->hits.load();
+  statistics.failures = specialization->failures.load();
+  return statistics;
+}
+
+template <typename T, typename C>
+inline typename Expression<T,C>::Cost Expression<T,C>::estimateCost() const {
+  double constant = 0;
+  std::vector<double> perElement;
+  getRoot().estimateCost(constant,perElement);
+  perElement.resize(collections.size());
+  Cost cost;
+  cost.constant = constant;
+  for ( size_t i = 0; i < collections.size(); i++ ) {
+    cost.perElement.emplace_back(collections[i], perElement[i]);
+  }
+  return cost;
+}
+
+template <typename T, typename C>
+inline std::vector<typename Expression<T,C>::Access> Expression<T,C>::getCollectionAccess() const {
+  std::vector<bool> scanned;
+  std::vector<size_t> points;
+  getRoot().analyzeAccess(scanned,points);
+  scanned.resize(collections.size());
+  points.resize(collections.size());
+  std::vector<Access> access(collections.size());
+  for ( size_t i = 0; i < collections.size(); i++ ) {
+    access[i] = Access{ .scanned = scanned[i], .points = points[i] };
+  }
+  return access;
+}
+
+template <typename T, typename C>
+inline double Expression<T,C>::Cost::estimate( const std::vector<size_t>& sizes ) const {
+  if ( sizes.size() < perElement.size() ) {
+    throw std::invalid_argument("LIMEX: Insufficient collection sizes provided");
+  }
+  double result = constant;
+  for ( size_t i = 0; i < perElement.size(); i++ ) {
+    result += perElement[i].second * sizes[i];
+  }
+  return result;
+}
+
+template <typename T, typename C>
+inline std::string Expression<T,C>::Cost::stringify() const {
+  auto number = [](double value) {
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    return std::string(digits, result.ptr);
+  };
+  std::string result = number(constant);
+  for ( auto& [name, cost] : perElement ) {
+    if ( cost == 0 ) continue;
+    result += " + " + number(cost) + "·|" + name + "|";
+  }
+  return result;
+}
+
+template <typename T, typename C>
+inline void Expression<T,C>::enableCache(size_t capacity, size_t elements) {
+  if constexpr (std::is_arithmetic_v<T>) {
+    if ( !getRoot().isPure() ) {
+      throw std::logic_error("LIMEX: Results of impure expressions cannot be cached");
+    }
+    cache = std::make_unique<Cache>();
+    cache->capacity = std::max<size_t>(capacity / Cache::SHARDS, 1);
+    cache->elements = elements;
+  }
+  else {
+    throw std::logic_error("LIMEX: Results can only be cached for arithmetic types");
+  }
+}
+
+template <typename T, typename C>
+inline void Expression<T,C>::clearCache() {
+  if ( !cache ) return;
+  for ( auto& shard : cache->shards ) {
+    std::lock_guard lock(shard.mutex);
+    shard.entries.clear();
+    shard.recency.clear();
+  }
+}
+
+template <typename T, typename C>
+inline typename Expression<T,C>::CacheStatistics Expression<T,C>::getCacheStatistics() const {
+  if ( !cache ) return CacheStatistics();
+  return CacheStatistics{ cache->hits.load(), cache->misses.load(), cache->bypasses.load() };
+}
+
+template <typename T, typename C>
+inline T Expression<T,C>::evaluateCached( const std::vector<T>& variableValues, const std::vector<C>& collectionValues) const {
+  // collections are identified by their contents, so that collections modified in place are recognized
+  std::vector<uint64_t> collections;
+  collections.reserve(collectionValues.size());
+  size_t elements = cache->elements;
+  for ( auto& collection : collectionValues ) {
+    auto hash = fingerprint(collection,elements);
+    if ( !hash.has_value() ) {
+      // contents of provided collections are unknown and hashing large collections may cost more than evaluating
+      cache->bypasses++;
+      return evaluateRoot(variableValues,collectionValues);
+    }
+    collections.push_back(hash.value());
+  }
+  uint64_t key = 0;
+  for ( auto& value : variableValues ) {
+    // -0 and 0 are distinguished as results may differ, e.g., for 1/x
+    double number = (double)value;
+    uint64_t bits;
+    std::memcpy(&bits, &number, sizeof(double));
+    key = Node<T,C>::mix(key, bits);
+  }
+  for ( auto hash : collections ) {
+    key = Node<T,C>::mix(key, hash);
+  }
+  auto& shard = cache->shards[key % Cache::SHARDS];
+  {
+    std::lock_guard lock(shard.mutex);
+    if ( auto it = shard.entries.find(key); it != shard.entries.end() && it->second.variableValues == variableValues && it->second.collections == collections ) {
+      cache->hits++;
+      shard.recency.splice(shard.recency.begin(), shard.recency, it->second.position);
+      return it->second.result;
+    }
+  }
+  cache->misses++;
+  T result = evaluateRoot(variableValues,collectionValues);
+  std::lock_guard lock(shard.mutex);
+  if ( auto it = shard.entries.find(key); it != shard.entries.end() ) {
+    // entry of colliding inputs or inserted concurrently is replaced
+    it->second.variableValues = variableValues;
+    it->second.collections = std::move(collections);
+    it->second.result = result;
+    shard.recency.splice(shard.recency.begin(), shard.recency, it->second.position);
+    return result;
+  }
+  if ( shard.entries.size() >= cache->capacity ) {
+    // evict the least recently used entry
+    shard.entries.erase(shard.recency.back());
+    shard.recency.pop_back();
+  }
+  shard.recency.push_front(key);
+  shard.entries.emplace(key, typename Cache::Entry{ variableValues, std::move(collections), result, shard.recency.begin() });
+  return result;
+}
+
+template <typename T, typename C>
+inline std::optional<uint64_t> Expression<T,C>::fingerprint( const C& collection, size_t& elements ) {
+  auto hashValue = [](uint64_t hash, const T& value) {
+    double number = (double)value;
+    uint64_t bits;
+    std::memcpy(&bits, &number, sizeof(double));
+    return Node<T,C>::mix(hash, bits);
+  };
+  // collections exceeding the remaining number of elements are not hashed
+  auto consume = [&elements](size_t size) {
+    if ( size > elements ) {
+      return false;
+    }
+    elements -= size;
+    return true;
+  };
+  uint64_t hash = 0x5bd1e995;
+  if constexpr (std::is_same_v< C, Collection<T> >) {
+    if ( collection.provider || !consume(collection.values.size() + collection.slots.size()) ) {
+      return std::nullopt;
+    }
+    for ( auto& value : collection.values ) {
+      hash = hashValue(hash, value);
+    }
+    // keys of keyed collections in the order of their slots
+    for ( auto& slot : collection.slots ) {
+      hash = Node<T,C>::mix(hash, slot.occupied ? (uint64_t)slot.key : 0x9e3779b97f4a7c15ull);
+    }
+    return Node<T,C>::mix(hash, collection.slots.size());
+  }
+  else if constexpr (std::is_same_v< C, std::vector<T> >) {
+    if ( !consume(collection.size()) ) {
+      return std::nullopt;
+    }
+    for ( auto& value : collection ) {
+      hash = hashValue(hash, value);
+    }
+    return Node<T,C>::mix(hash, collection.size());
+  }
+  else {
+    if ( !consume(1) ) {
+      return std::nullopt;
+    }
+    return hashValue(hash, collection);
+  }
+}
+
+template <typename T, typename C>
+inline std::vector<T> Expression<T,C>::evaluateBatch( const std::vector< std::vector<T> >& variableColumns, const std::vector<C>& collectionValues) const {
+  size_t rows = variableColumns.empty() ? 1 : variableColumns.front().size();
+  std::vector<T> results(rows);
+#ifdef LIMEX_METRICS
+  if ( Metrics::isEnabled() ) {
+    Metrics::measureBatch(rows, [&]() { getRoot().evaluateBatch(variableColumns,collectionValues,0,results); });
+    return results;
+  }
+#endif
+  getRoot().evaluateBatch(variableColumns,collectionValues,0,results);
+  return results;
+}
+
+template <typename T, typename C>
+inline void Expression<T,C>::evaluateBatch( Pool& pool, std::span<T> results, const std::vector< std::vector<T> >& variableColumns, const std::vector<C>& collectionValues) const {
+  auto& root = getRoot();
+  auto budget = Budget::getCurrent();
+  auto evaluate = [&]() {
+    pool.run([&](size_t worker) {
+      auto [begin, end] = pool.getRange(worker, results.size());
+      if ( begin == end ) return;
+      std::optional<Budget> inherited;
+      if ( budget ) {
+        inherited.emplace(budget->getDeadline(), budget->getToken(), budget->getInterval());
+      }
+      auto start = std::chrono::steady_clock::now();
+      root.evaluateBatch(variableColumns,collectionValues,begin,results.subspan(begin, end - begin));
+      pool.record(worker, end - begin, std::chrono::steady_clock::now() - start);
+    });
+  };
+#ifdef LIMEX_METRICS
+  if ( Metrics::isEnabled() ) {
+    return Metrics::measureBatch(results.size(), evaluate);
+  }
+#endif
+  evaluate();
+}
+
+template <typename T, typename C>
+inline Node<T,C> Expression<T,C>::parse() {
+#ifdef LIMEX_METRICS
+  if ( Metrics::isEnabled() ) {
+    auto start = std::chrono::steady_clock::now();
+    try {
+      auto node = buildTree( Type::group, tokenize(input).children, std::nullopt );
+      Metrics::recordParse(std::chrono::steady_clock::now() - start);
+      return node;
+    }
+    catch ( const std::exception& ) {
+      Metrics::recordError(Metrics::Category::PARSING);
+      throw;
+    }
+  }
+#endif
+  auto rootToken = tokenize(input);
+//std::cerr << rootToken.stringify() << std::endl;
+  return buildTree( Type::group, rootToken.children, std::nullopt );
+}
+
+template <typename T, typename C>
+inline Node<T,C> Expression<T,C>::scan() {
+  scan(tokenize(input).children);
+  // placeholder until the tree is built
+  return Node<T,C>(this, 0.0);
+}
+
+template <typename T, typename C>
+inline void Expression<T,C>::scan(const std::vector<Token>& tokens) {
+  // register names in the same order as buildTree
+  for ( size_t i = 0; i < tokens.size(); i++ ) {
+    auto& token = tokens[i];
+    switch ( token.type ) {
+      case Token::Type::VARIABLE:
+        if ( i > 0 || !isDefinition(tokens) ) {
+          getIndex(variables,token.value);
+        }
+        break;
+      case Token::Type::COLLECTION:
+      case Token::Type::INDEXED_VARIABLE:
+        getIndex(collections,token.value);
+        break;
+      case Token::Type::FUNCTION_CALL:
+      case Token::Type::AGGREGATION:
+        handle.getIndex(token.value);
+        break;
+      case Token::Type::OPERATOR:
+        if ( token.category == Token::Category::INFIX && (int)infixTypes.at(token.value) >= (int)Type::assign ) {
+          target = tokens[0].value;
+        }
+        break;
+      default:
+        break;
+    }
+    scan(token.children);
+  }
+}
+
+template <typename T, typename C>
+inline bool Expression<T,C>::isDefinition(const std::vector<Token>& tokens) {
+  // tokens start with a variable followed by an assignment without compound operation
+  return ( 
+    tokens.size() > 1 && 
+    tokens[0].type == Token::Type::VARIABLE &&
+    tokens[1].category == Token::Category::INFIX && 
+    tokens[1].type == Token::Type::OPERATOR && 
+    infixTypes.contains(tokens[1].value) &&
+    infixTypes.at(tokens[1].value) == Type::assign
+  );
+}
+
+template <typename T, typename C>
+inline Token Expression<T,C>::tokenize(const std::string& input) {
+  Token root = Token( Token::Category::OPERAND, Token::Type::GROUP, "" );
+  std::stack< std::pair<Token*,std::string_view> > groupStack;
+  groupStack.emplace(&root,"#");
+  size_t pos = 0;
+  Token::Category expected = Token::Category::PREFIX;
+
+  while (pos < input.length()) {
+    skipWhitespaces(input,pos);
+    if ( pos == input.length() ) break; 
+
+    if ( expected == Token::Category::PREFIX ) {
+      // Consume prefix
+      std::string match = fetch(input, pos, prefix);
+      if ( !match.empty() ) {
+        pos += match.size();
+        if ( pos == input.length() ) {
+          throw std::runtime_error("LIMEX: Prefix operator must be followed by operand: " + input.substr(0,pos));
+        }; 
+        groupStack.top().first->children.emplace_back(Token::Category::PREFIX, Token::Type::OPERATOR, std::move(match));
+      }
+      expected = Token::Category::OPERAND;
+    }
+
+    if ( expected == Token::Category::OPERAND ) {
+      if ( auto match = fetch(input, pos, keywords); !match.empty() ) {
+//std::cerr << "keywords" << std::endl;
+        pos += match.size();
+        if ( match == "true" ) {
+          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::NUMBER, std::to_string(true));
+        }
+        else if ( match == "false" ) {
+          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::NUMBER, std::to_string(false));
+        }
+        expected = Token::Category::INFIX;
+        continue;
+      }
+      else if ( startsWith(input,pos,ternary[0]) ) {
+        // ternary keyowrd "if"
+        pos += 2;
+        expected = Token::Category::PREFIX;
+        groupStack.top().first->children.emplace_back(Token::Category::PREFIX, Token::Type::GROUP, std::string(ternary[0]));
+        groupStack.emplace(&groupStack.top().first->children.back(),ternary[1]); // groub closed by "then"
+        continue;
+      }
+      else if ( startsWith(input,pos,ternary[1]) || startsWith(input,pos,ternary[2]) ) {
+        // close current group upon then and else
+        expected = Token::Category::INFIX;
+      }
+      else if ( input[pos] == '"' ) {
+        // Consume string literal, quotes and backslashes within the string are escaped by a backslash
+        std::string string;
+        size_t start = pos++;
+        while ( pos < input.length() && input[pos] != '"' ) {
+          if ( input[pos] == '\\' && pos + 1 < input.length() ) {
+            pos++;
+          }
+          string += input[pos++];
+        }
+        if ( pos == input.length() ) {
+          throw std::runtime_error("LIMEX: Unterminated string literal at: " + input.substr(0,start + 1) );
+        }
+        pos++;
+        expected = Token::Category::POSTFIX;
+        groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::STRING, std::move(string));
+      }
+      else if ( isnumeric( input[pos] ) ) {
+        // Consume numbers
+        size_t start = pos;
+        while (pos < input.length() && isnumeric( input[pos] ) ) {
+          pos++;
+        }
+        std::string number = input.substr(start, pos - start);
+        expected = Token::Category::POSTFIX;
+        groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::NUMBER, number);
+      }
+      else if ( isalphanumeric( input[pos] ) ) {
+        // Consume name
+        size_t start = pos;
+        while (pos < input.length() && isalphanumeric( input[pos] ) ) {
+          pos++;
+        }
+        std::string name = input.substr(start, pos - start);
+        if ( pos < input.length() && input[pos] == '(' ) {
+          ++pos;
+          expected = Token::Category::PREFIX;
+          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::FUNCTION_CALL, name);
+          groupStack.emplace(&groupStack.top().first->children.back(),")");
+          continue;
+        }
+        else if ( startsWith(input,pos,"[]") ) {
+          pos += 2;
+          expected = Token::Category::OPERAND;
+          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::COLLECTION, name);
+        }
+        else if ( pos < input.length() && input[pos] == '[' ) {
+          ++pos;
+          expected = Token::Category::PREFIX;
+          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::INDEXED_VARIABLE, name);
+          groupStack.emplace(&groupStack.top().first->children.back(),"]");
+          continue;
+        }
+        else if ( pos < input.length() && input[pos] == '{' ) {
+          ++pos;
+          expected = Token::Category::PREFIX;
+          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::AGGREGATION, name);
+          groupStack.emplace(&groupStack.top().first->children.back(),"}");
+          continue;
+        }
+        else {
+          expected = Token::Category::POSTFIX;
+          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::VARIABLE, name);
+        }
+      }
+      else if ( auto match = fetch(input, pos, symbolic_names); !match.empty() ) {
+        pos += match.size();
+        if ( pos < input.length() && input[pos] == '(' ) {
+          ++pos;
+          expected = Token::Category::PREFIX;
+          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::FUNCTION_CALL, aliases.at(match));
+          groupStack.emplace(&groupStack.top().first->children.back(),")");
+          continue;
+        }
+        else if ( pos < input.length() && input[pos] == '{' ) {
+          ++pos;
+          expected = Token::Category::PREFIX;
+          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::AGGREGATION, aliases.at(match));
+          groupStack.emplace(&groupStack.top().first->children.back(),"}");
+          continue;
+        }
+        throw std::runtime_error("LIMEX: Symbolic names must be followed by parenthesis or braces: " + input.substr(0,pos));
+      }
+      else if ( input[pos] == '(' ) {
+        ++pos;
+        expected = Token::Category::PREFIX;
+        groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::GROUP);
+        groupStack.emplace(&groupStack.top().first->children.back(),")");
+        continue;
+      }
+      else if ( input[pos] == '{' ) {
+        ++pos;
+        expected = Token::Category::PREFIX;
+        groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::SET);
+        groupStack.emplace(&groupStack.top().first->children.back(),"}");
+        continue;
+      }
+      else if ( input[pos] == '[' ) {
+        ++pos;
+        expected = Token::Category::PREFIX;
+        groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::SEQUENCE);
+        groupStack.emplace(&groupStack.top().first->children.back(),"]");
+        continue;
+      }
+      else {
+//std::cerr << "IF" << startsWith(input,pos,"if") << "/" << pos << std::endl;
+        throw std::runtime_error("LIMEX: Unexpected operand at: " + input.substr(0,pos) );
+      }
+    }
+
+    if ( expected == Token::Category::POSTFIX ) {
+      // Consume postfix
+      std::string match = fetch(input, pos, postfix);
+      if ( !match.empty() ) {
+        pos += match.size();
+        groupStack.top().first->children.emplace_back(Token::Category::POSTFIX, Token::Type::OPERATOR, std::move(match));
+      }
+      expected = Token::Category::INFIX;
+    }
+
+    skipWhitespaces(input,pos);
+    if ( pos == input.length() ) break; 
+
+    if ( startsWith(input,pos,groupStack.top().second) ) {
+      if ( groupStack.top().second == "then" ) {
+//std::cerr << " ... then ..." << std::endl;
+        auto match = groupStack.top().second;
+        // Consume closure of group and open next group
+        pos += match.size();
+        expected = Token::Category::PREFIX;
+        groupStack.pop();
+        groupStack.top().first->children.emplace_back(Token::Category::INFIX, Token::Type::GROUP, std::string(ternary[1]));
+        groupStack.emplace(&groupStack.top().first->children.back(), ternary[2]);
+        continue;
+      }
+      if ( groupStack.top().second == ":" || groupStack.top().second == ternary[2] ) {
+//std::cerr << " ... else ..." << std::endl;
+        auto match = groupStack.top().second;
+        // Consume closure of group
+        pos += groupStack.top().second.size();
+        expected = Token::Category::PREFIX;
+        groupStack.pop();
+        groupStack.top().first->children.emplace_back(Token::Category::INFIX, Token::Type::OPERATOR, std::string(match));
+        continue;
+      }
+      // Consume closure of group
+      pos += groupStack.top().second.size();
+      expected = Token::Category::POSTFIX;
+      groupStack.pop();
+      continue;
+    }
+
+    if ( expected == Token::Category::INFIX ) {
+      // Consume separator
+      if ( input[pos] == ',' ) {
+        groupStack.top().first->children.emplace_back(Token::Category::INFIX, Token::Type::SEPARATOR, ",");
+        ++pos;
+        expected = Token::Category::PREFIX;
+        continue;
+      }
+      
+      // Consume ternary
+      if ( input[pos] == '?' ) {
+//std::cerr << "TERNARY" << std::endl;
+        ++pos;
+        expected = Token::Category::PREFIX;
+        groupStack.top().first->children.emplace_back(Token::Category::INFIX, Token::Type::GROUP, "?");
+        groupStack.emplace(&groupStack.top().first->children.back(), ":");
+        continue;
+      }
+      // Consume infix
+      std::string match = fetch(input, pos, infix);
+      if ( !match.empty() ) {
+        pos += match.size();
+        groupStack.top().first->children.emplace_back(Token::Category::INFIX, Token::Type::OPERATOR, std::move(match));
+        expected = Token::Category::PREFIX;
+        continue;
+      }
+    }
+
+    // Invalid character
+    throw std::runtime_error("LIMEX: Unexpected character: " + input.substr(0,pos));
+  }
+  if (groupStack.size() != 1) {
+    throw std::runtime_error("LIMEX: Unbalanced parentheses, brackets, or braces:" + input.substr(0,pos));
+  }
+  return root;
+}
+
+template <typename T, typename C>
+inline size_t Expression<T,C>::skipWhitespaces(const std::string& input, size_t& pos) {
+  // Skip whitespaces
+  while ( pos < input.length() && std::isspace( input[pos] ) ) {
+    ++pos;     
+  }
+  return pos;
+}
+
+template <typename T, typename C>
+inline bool Expression<T,C>::startsWith(const std::string& input, size_t start, std::string_view candidate) {
+  if ( input.compare(start, candidate.size(), candidate) == 0 ) {
+    // `input` at `start` begins with candidate
+    if ( !isalphanumeric( candidate.back() ) ) {
+//std::cerr << "Found " << candidate << " after " << input.substr(0,start) << std::endl;
+      return true;
+    }
+    if ( start + candidate.size() == input.size() || !isalphanumeric( input[start + candidate.size()] ) ) {
+//std::cerr << "Found " << candidate << " after " << input.substr(0,start) << std::endl;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+template <typename T, typename C>
+template <size_t N>
+inline std::string Expression<T,C>::fetch(const std::string& input, size_t start, const std::array<std::string_view, N>& prefix) {
+  for (const auto& candidate : prefix) {
+    if ( startsWith(input,start,candidate) ) {
+      return std::string(candidate);
+    }
+  }
+  return ""; // No match found
+}
+
+template <typename T, typename C>
+inline size_t Expression<T,C>::getIndex(std::vector<std::string>& container, std::string name) {
+  for ( size_t i = 0; i < container.size(); i++) {
+    if ( container[i] == name ) {
+      return i;
+    }
+  }
+  container.push_back(name);
+  return container.size()-1;
+}
+ 
+template <typename T, typename C>
+inline Node<T,C> Expression<T,C>::buildTree( Type type, const std::vector<Token>& tokens, std::optional<size_t> index ) {
+  std::vector< std::variant< double, size_t, Node<T,C> > > operands;
+  if ( index.has_value() ) {
+    operands.emplace_back( index.value() );
+  }
+
+  std::stack< Node<T,C> > nodeStack;
+  std::stack< Type > operatorStack;
+
+  auto createNode = [&](const Token& token) {
+    switch (token.type) {
+      case Token::Type::NUMBER: {
+        double value;
+        auto [end, error] = std::from_chars(token.value.data(), token.value.data() + token.value.size(), value);
+        if ( error != std::errc() || end != token.value.data() + token.value.size() ) {
+          throw std::runtime_error("LIMEX: Invalid number '" + token.value + "'");
+        }
+        return Node<T,C>(this, value);
+      }
+      case Token::Type::STRING: {
+        // strings are replaced by their codes
+        Node<T,C> node(this, (double)handle.intern(token.value));
+        node.quoted = true;
+        return node;
+      }
+      case Token::Type::VARIABLE:
+        return Node<T,C>(this, Type::variable, token.value);
+      case Token::Type::COLLECTION:
+        return Node<T,C>(this, Type::collection, token.value);
+      case Token::Type::GROUP:
+        return buildTree(Type::group, token.children);
+      case Token::Type::SET:
+        return buildTree(Type::set, token.children);    
+      case Token::Type::SEQUENCE:
+        return buildTree(Type::sequence, token.children);    
+      case Token::Type::FUNCTION_CALL:
+        return buildTree(Type::function_call, token.children, handle.getIndex(token.value));    
+      case Token::Type::AGGREGATION:
+        return buildTree(Type::aggregation, token.children, handle.getIndex(token.value));    
+      case Token::Type::INDEXED_VARIABLE:
+        if constexpr (std::is_same_v< C, std::vector<T> > || std::is_same_v< C, Collection<T> >) {
+          return buildTree(Type::index, token.children, getIndex(getCollectionNames(),token.value));
+        }
+        else if constexpr (std::is_same_v< C, T >) {
+          std::vector<Token> children;
+          children.emplace_back(Token::Category::OPERAND, Token::Type::COLLECTION, token.value);
+          children.emplace_back(Token::Category::INFIX, Token::Type::SEPARATOR, ",");
+          children.insert(children.end(), token.children.begin(), token.children.end());
+          return buildTree(Type::function_call, children, handle.getIndex("at"));
+        }
+        else {
+          throw std::logic_error("LIMEX:Collection type not supported");
+        }
+      default:
+        throw std::logic_error("LIMEX: Unexpected token type for operand");
+    }
+  };
+
+  auto applyOperator = [&](Type operatorType) {
+    // process ternary operator
+    if ( operatorType == Type::_else ) {
+      if ( operatorStack.size() < 2) {
+        throw std::logic_error("LIMEX: Insufficient operators for ternary operator");
+      }
+      operatorStack.pop();
+      if ( operatorStack.top() != Type::_then_ ) {
+        throw std::logic_error("LIMEX: Wrong operators for ternary operator");
+      }
+      if (nodeStack.size() < 3) {
+        throw std::logic_error("LIMEX: Insufficient operands for ternary operator");
+      }
+      // Pop three operands and apply the operator
+      Node<T,C> else_result = std::move(nodeStack.top());
+      nodeStack.pop();
+      Node<T,C> then_result = std::move(nodeStack.top());
+      then_result.type = Type::group;
+      nodeStack.pop();
+      Node<T,C> condition = std::move(nodeStack.top());
+      if ( condition.type == Type::if_ ) {
+        condition.type = Type::group;
+      }
+      nodeStack.pop();
+
+      nodeStack.push(Node<T,C>(this,Type::if_then_else, {std::move(condition), std::move(then_result), std::move(else_result) }));
+      return;
+    }
+
+    // process all types of assignments
+    if ( (int)operatorType >= (int)Type::assign ) {
+      if (nodeStack.size() < 2) {
+        throw std::runtime_error("LIMEX: Insufficient operands for assignment");
+      }
+      Node<T,C> right = std::move(nodeStack.top());
+      nodeStack.pop();
+      Node<T,C> left = std::move(nodeStack.top());
+      nodeStack.pop();
+      if ( left.type != Type::variable ) {
+        throw std::runtime_error("LIMEX: illegal target for assignment");
+      }
+      if ( operatorType == Type::assign ) {
+        nodeStack.push(Node<T,C>(this,Type::assign, {std::move(right) }));
+      }
+      else {
+        // add_assign, subtract_assign, multiply_assign, or divide_assign
+        nodeStack.push(Node<T,C>(this,operatorType, {std::move(left), std::move(right) }));
+      }
+      return;
+    }
+
+    if (nodeStack.size() < 2) {
+      throw std::logic_error("LIMEX: Insufficient operands for infix operator");
+    }
+    // Pop two operands and apply the operator
+    Node<T,C> right = std::move(nodeStack.top());
+    nodeStack.pop();
+    Node<T,C> left = std::move(nodeStack.top());
+    nodeStack.pop();
+
+    nodeStack.push(Node<T,C>(this,operatorType, {std::move(left), std::move(right)}));
+    return;
+  };
+
+  for ( size_t i = 0; i < tokens.size(); i++ ) {
+//std::cerr << "Token: '" << tokens[i].value << "', " << (i+1) << "/" << tokens.size() << std::endl;
+    if ( tokens[i].category == Token::Category::PREFIX && tokens[i].type == Token::Type::GROUP ) {
+      // keyword "if" starts a group, other prefix operators are treated separately
+      auto node = buildTree(Type::if_ , tokens[i].children); 
+      nodeStack.push(std::move(node));
+      continue;
+    }
+    if ( tokens[i].category == Token::Category::INFIX && tokens[i].type == Token::Type::GROUP ) {
+      // operators '?' and keyword "then" start a group, other infix operators are treated separately
+      auto node = buildTree(Type::_then_ , tokens[i].children); 
+      nodeStack.push(std::move(node));
+      operatorStack.push(Type::_then_);
+      continue;
+    }
+    if ( tokens[i].category == Token::Category::OPERAND ) {
+      // the target of a definition is not a variable of the expression
+      auto node = ( i == 0 && isDefinition(tokens) ) ? 
+        Node<T,C>(this, Type::variable, std::vector< std::variant< double, size_t, Node<T,C> > >()) : 
+        createNode( tokens[i] );
+      // apply postfix and prefix operators
+      if ( i + 1 < tokens.size() && tokens[i+1].category == Token::Category::POSTFIX ) {
+        node = Node<T,C>(this, postfixTypes.at(tokens[i+1].value), { std::move(node) });
+      }
+      if ( i > 0 && tokens[i-1].category == Token::Category::PREFIX ) {
+        node = Node<T,C>(this, prefixTypes.at(tokens[i-1].value), { std::move(node) });
+      }
+      nodeStack.push(std::move(node));
+    }
+    else if ( tokens[i].type == Token::Type::SEPARATOR ) {
+      // separators create separate operand nodes
+      // clear stack and apply all operators on stack
+      while ( !operatorStack.empty() ) {
+        applyOperator(operatorStack.top());
+        operatorStack.pop();
+      }
+      if (nodeStack.size() != 1) {
+        throw std::runtime_error("LIMEX: Invalid expression - unmatched operators or operands");
+      }
+      operands.emplace_back( std::move(nodeStack.top()) );
+      nodeStack.pop();
+      continue;
+    }
+    else if ( tokens[i].category == Token::Category::INFIX ) {
+      Type operatorType = infixTypes.at(tokens[i].value);
+      if ( (int)operatorType >= (int)Type::assign ) {
+        if ( i != 1 ) {
+          throw std::runtime_error("LIMEX: Assignment must start with a variable followed by the assignment operator");
+        }
+        getTargetName() = tokens[0].value;
+      }
+      // apply operators on stack with smaller or equal precedence number
+      while ( 
+       !operatorStack.empty() && 
+       precedences.at(operatorStack.top()) <= precedences.at(operatorType) && 
+       operatorStack.top() != Type::_then_ 
+     ) {
+//std::cerr << "apply prior operator: " << (int)operatorStack.top() << "/" << (int)Type::if_then_else << std::endl;
+        applyOperator(operatorStack.top());
+        operatorStack.pop();
+      }
+//std::cerr << "add operator: " << (int)operatorType << "/" << (int)Type::if_then_else << std::endl;
+      operatorStack.push(operatorType);
+    }
+    // skip prefix and postfix tokens
+  }
+
+  // apply all operators on stack
+//std::cerr << "flush" << std::endl;
+  while ( !operatorStack.empty() ) {
+    applyOperator(operatorStack.top());
+    operatorStack.pop();
+  }
+
+  if (nodeStack.size() != 1) {
+    throw std::logic_error("LIMEX: Invalid expression - unmatched operators or operands");
+  }
+
+  operands.emplace_back( std::move(nodeStack.top()) );
+
+  if ( 
+    ( type == Type::function_call || type == Type::aggregation ) && 
+    !( operands.size() == 2 && std::get< Node<T,C> >(operands[1]).type == Type::collection )
+  ) {
+    // validate number of explicitly given arguments
+    handle.validate( index.value(), operands.size() - 1 );
+  }
+  bool quoted = ( type == Type::set && Node<T,C>::pack(operands) );
+  Node<T,C> node(this, type, std::move(operands));
+  node.quoted = quoted;
+  return node;
+}
+
+template <typename T, typename C>
+inline std::string Expression<T,C>::stringify() const {
+  return getRoot().stringify();
+}
+
+template <typename T, typename C>
+inline void Expression<T,C>::serialize( std::string& buffer, Notation notation ) const {
+  auto& root = getRoot();
+  if ( notation == Notation::INFIX && root.type == Type::group && root.operands.size() == 1 ) {
+    // the parser encloses the entire expression in a group
+    std::get< Node<T,C> >(root.operands[0]).serialize(buffer, notation);
+    return;
+  }
+  root.serialize(buffer, notation);
+}
+
+template <typename T, typename C>
+inline std::string Expression<T,C>::serialize( Notation notation ) const {
+  std::string buffer;
+  serialize(buffer, notation);
+  return buffer;
+}
+
+/*******************************
+ ** Handle
+ *******************************/
+
+template <typename T, typename C>
+inline const typename Handle<T,C>::Layer& Handle<T,C>::getBuiltins() {
+  // built-in callables are registered once by a handle without builtins
+  static const Layer builtins = []() {
+    static const Layer empty;
+    Handle<T,C> handle(&empty);
+    handle.initialize();
+    return handle.overlay ? std::move(*handle.overlay) : Layer();
+  }();
+  return builtins;
+}
+
+template <typename T, typename C>
+inline const typename Handle<T,C>::Callable& Handle<T,C>::getCallable(size_t index) const {
+  if ( index < builtins->callables.size() ) {
+    return builtins->callables[index];
+  }
+  index -= builtins->callables.size();
+  if ( !overlay || index >= overlay->callables.size() ) {
+    throw std::out_of_range("LIMEX: Callable index out of range");
+  }
+  return overlay->callables[index];
+}
+
+template <typename T, typename C>
+inline std::vector<std::string> Handle<T,C>::getNames() const {
+  std::vector<std::string> names;
+  names.reserve(size());
+  for ( size_t index = 0; index < size(); index++ ) {
+    names.push_back(getCallable(index).name);
+  }
+  return names;
+}
+
+template <typename T, typename C>
+inline size_t Handle<T,C>::getIndex(const std::string& name) const {
+  if ( auto it = builtins->indices.find(name); it != builtins->indices.end() ) {
+    return it->second;
+  }
+  if ( overlay ) {
+    if ( auto it = overlay->indices.find(name); it != overlay->indices.end() ) {
+      return builtins->callables.size() + it->second;
+    }
+  }
+  throw std::logic_error("LIMEX: Unknown callable '" + name + "'");
+}
+
+template <typename T, typename C>
+inline size_t Handle<T,C>::intern(const std::string& string) const {
+  if ( auto code = getCode(string) ) {
+    return code;
+  }
+  std::unique_lock lock(dictionary->mutex);
+  auto [it, inserted] = dictionary->codes.try_emplace(string, dictionary->strings.size() + 1);
+  if ( inserted ) {
+    dictionary->strings.push_back(string);
+  }
+  return it->second;
+}
+
+template <typename T, typename C>
+inline size_t Handle<T,C>::getCode(const std::string& string) const {
+  std::shared_lock lock(dictionary->mutex);
+  auto it = dictionary->codes.find(string);
+  return it != dictionary->codes.end() ? it->second : 0;
+}
+
+template <typename T, typename C>
+inline double Handle<T,C>::encode(const std::string& string) const {
+  // NaN is unequal to every value, including NaN given for other unknown strings
+  size_t code = getCode(string);
+  return code ? (double)code : std::numeric_limits<double>::quiet_NaN();
+}
+
+template <typename T, typename C>
+inline std::string Handle<T,C>::getString(size_t code) const {
+  std::shared_lock lock(dictionary->mutex);
+  if ( code == 0 || code > dictionary->strings.size() ) {
+    throw std::out_of_range("LIMEX: Unknown string code " + std::to_string(code));
+  }
+  return dictionary->strings[code - 1];
+}
+
+template <typename T, typename C>
+inline void Handle<T,C>::add(const std::string& name, std::function<T(const std::vector<T>&)> implementation) {
+  if ( builtins->indices.contains(name) || ( overlay && overlay->indices.contains(name) ) ) {
+    throw std::runtime_error("LIMEX: Callable with name '" + name + "' already exists");
+  }
+  if ( !overlay ) {
+    overlay = std::make_shared<Layer>();
+  }
+  else if ( overlay.use_count() > 1 ) {
+    // copy overlay shared with other handles before modifying it
+    overlay = std::make_shared<Layer>(*overlay);
+  }
+  overlay->indices[name] = overlay->callables.size();
+  overlay->callables.push_back( Callable{ name, std::move(implementation), nullptr, Descriptor<T>() } );
+}
+
+template <typename T, typename C>
+inline void Handle<T,C>::add(const std::string& name, std::function<T(const std::vector<T>&)> implementation, std::function<void(const std::vector< std::span<const T> >&, std::span<T>)> columnImplementation) {
+  add(name, std::move(implementation));
+  overlay->callables.back().descriptor.column = std::move(columnImplementation);
+}
+
+template <typename T, typename C>
+inline void Handle<T,C>::add(const std::string& name, std::function<T(const std::vector<T>&)> implementation, Descriptor<T> descriptor) {
+  if ( descriptor.minArity > descriptor.maxArity ) {
+    throw std::logic_error("LIMEX: Illegal arity range for callable '" + name + "'");
+  }
+  add(name, std::move(implementation));
+  overlay->callables.back().descriptor = std::move(descriptor);
+}
+
+template <typename T, typename C>
+inline void Handle<T,C>::validate(size_t index, size_t arguments) const {
+  auto& callable = getCallable(index);
+  if ( arguments < callable.descriptor.minArity || arguments > callable.descriptor.maxArity ) {
+    throw std::runtime_error("LIMEX: Illegal number of arguments for callable '" + callable.name + "'");
+  }
+}
+
+template <typename T, typename C>
+inline void Handle<T,C>::addAwaitable(const std::string& name, std::function<std::vector<T>(const std::vector< std::vector<T> >&)> bulkImplementation) {
+  // synchronous evaluation passes a single request to the bulk implementation
+  add(name, [bulkImplementation](const std::vector<T>& arguments) -> T {
+    auto results = bulkImplementation({ arguments });
+    if ( results.size() != 1 ) {
+      throw std::runtime_error("LIMEX: Bulk implementation returned wrong number of results");
+    }
+    return results.front();
+  });
+  overlay->callables.back().awaitable = std::move(bulkImplementation);
+}
+
+// Define built-in functions
+template <>
+inline void Handle<double>::initialize() {
+  add(
+    std::string("if_then_else"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.size() != 3) throw std::runtime_error("LIMEX: if_then_else() requires exactly two arguments");
+      return args[0] ? args[1] : args[2];
+    },
+    Descriptor<double>{ .minArity = 3, .maxArity = 3, .pure = true }
+  );
+
+  add(
+    std::string("n_ary_if"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.empty() || args.size()%2 != 1) throw std::runtime_error("LIMEX: n_ary_if() requires an unconditional argument");
+      for ( size_t i = 0; i < args.size()/2; i++ ) {
+        if ( args[2*i] ) return args[2*i+1];
+      }
+      return args.back();
+    },
+    Descriptor<double>{ .minArity = 1, .pure = true }
+  );
+
+  add(
+    std::string("abs"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.size() != 1) throw std::runtime_error("LIMEX: abs() requires exactly one argument");
+      return args[0] >= 0 ? args[0] : -args[0];
+    },
+    Descriptor<double>{ 
+      .minArity = 1, .maxArity = 1, .pure = true,
+      .derivative = [](const std::vector<double>& args, size_t) -> double { return args[0] >= 0 ? 1.0 : -1.0; },
+      .interval = [](const std::vector< std::pair<double,double> >& bounds) -> std::pair<double,double> {
+        auto [lower, upper] = bounds[0];
+        if ( lower >= 0 ) return { lower, upper };
+        if ( upper <= 0 ) return { -upper, -lower };
+        return { 0.0, std::max(-lower, upper) };
+      }
+    }
+  );
+
+  add(
+    std::string("pow"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.size() != 2) throw std::runtime_error("LIMEX: pow() requires exactly two arguments");
+      return std::pow(args[0],args[1]);
+    },
+    Descriptor<double>{ 
+      .minArity = 2, .maxArity = 2, .pure = true,
+      .derivative = [](const std::vector<double>& args, size_t argument) -> double {
+        return argument == 0 ? args[1] * std::pow(args[0],args[1] - 1) : std::pow(args[0],args[1]) * std::log(args[0]);
+      },
+      .cost = 20.0
+    }
+  );
+
+  add(
+    std::string("sqrt"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.size() != 1) throw std::runtime_error("LIMEX: sqrt() requires exactly one argument");
+      return std::sqrt(args[0]);
+    },
+    Descriptor<double>{ 
+      .minArity = 1, .maxArity = 1, .pure = true, .monotonicity = Descriptor<double>::Monotonicity::INCREASING,
+      .derivative = [](const std::vector<double>& args, size_t) -> double { return 0.5 / std::sqrt(args[0]); },
+      .cost = 10.0
+    }
+  );
+
+  add(
+    std::string("cbrt"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.size() != 1) throw std::runtime_error("LIMEX: cbrt() requires exactly one argument");
+      return std::cbrt(args[0]);
+    },
+    Descriptor<double>{ 
+      .minArity = 1, .maxArity = 1, .pure = true, .monotonicity = Descriptor<double>::Monotonicity::INCREASING,
+      .derivative = [](const std::vector<double>& args, size_t) -> double { return 1.0 / (3.0 * std::pow(std::cbrt(args[0]),2)); },
+      .cost = 10.0
+    }
+  );
+
+  add(
+    std::string("sum"), 
+    [](const std::vector<double>& args) -> double
+    {
+      double result = 0.0;
+      for ( double value : args ) {
+        result += value;
+      }
+      return result;
+    },
+    Descriptor<double>{ 
+      .pure = true, .commutative = true, .monotonicity = Descriptor<double>::Monotonicity::INCREASING,
+      .derivative = [](const std::vector<double>&, size_t) -> double { return 1.0; }
+    }
+  );
+
+  add(
+    std::string("avg"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.empty()) throw std::runtime_error("LIMEX: avg{} requires at least one argument");
+      double result = 0.0;
+      for ( double value : args ) {
+        result += value;
+      }
+      return result / args.size();
+    },
+    Descriptor<double>{ 
+      .minArity = 1, .pure = true, .commutative = true, .monotonicity = Descriptor<double>::Monotonicity::INCREASING,
+      .derivative = [](const std::vector<double>& args, size_t) -> double { return 1.0 / args.size(); }
+    }
+  );
+
+  add(
+    std::string("count"), 
+    [](const std::vector<double>& args) -> double
+    {
+      return args.size();
+    },
+    Descriptor<double>{ .pure = true, .commutative = true, .exactlyCommutative = true }
+  );
+
+  add(
+    std::string("min"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.empty()) throw std::runtime_error("LIMEX: min{} requires at least one argument");
+      double result = DBL_MAX;
+      for ( double value : args ) {
+        if ( result > value ) {
+          result = value;
+        };
       }
-      else if ( auto match = fetch(input, pos, symbolic_names); !match.empty() ) {
-        pos += match.size();
-        if ( pos < input.length() && input[pos] == '(' ) {
-          ++pos;
-          expected = Token::Category::PREFIX;
-          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::FUNCTION_CALL, aliases.at(match));
-          groupStack.emplace(&groupStack.top().first->children.back(),")");
-          continue;
-        }
-        else if ( pos < input.length() && input[pos] == '{' ) {
-          ++pos;
-          expected = Token::Category::PREFIX;
-          groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::AGGREGATION, aliases.at(match));
-          groupStack.emplace(&groupStack.top().first->children.back(),"}");
-          continue;
+      return result;
+    },
+    Descriptor<double>{ .minArity = 1, .pure = true, .commutative = true, .exactlyCommutative = true, .monotonicity = Descriptor<double>::Monotonicity::INCREASING }
+  );
+
+  add(
+    std::string("max"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.empty()) throw std::runtime_error("LIMEX: max{} requires at least one argument");
+      double result = -DBL_MAX;
+      for ( double value : args ) {
+        if ( result < value ) {
+          result = value;
+        };
+      }
+      return result;
+    },
+    Descriptor<double>{ .minArity = 1, .pure = true, .commutative = true, .exactlyCommutative = true, .monotonicity = Descriptor<double>::Monotonicity::INCREASING }
+  );
+
+  add(
+    std::string("element_of"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.empty()) throw std::runtime_error("LIMEX: ∈ {...} requires at least one argument");
+      for ( size_t i = 1; i < args.size(); i++ ) {
+        if (args[0] == args[i]) {
+          return true;
         }
-        throw std::runtime_error("LIMEX: Symbolic names must be followed by parenthesis or braces: " + input.substr(0,pos));
       }
-      else if ( input[pos] == '(' ) {
-        ++pos;
-        expected = Token::Category::PREFIX;
-        groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::GROUP);
-        groupStack.emplace(&groupStack.top().first->children.back(),")");
-        continue;
+      return false;
+    },
+    Descriptor<double>{ .minArity = 1, .pure = true }
+  );
+
+  add(
+    std::string("not_element_of"), 
+    [](const std::vector<double>& args) -> double
+    {
+      if (args.empty()) throw std::runtime_error("LIMEX: ∉ {...} requires at least one argument");
+      for ( size_t i = 1; i < args.size(); i++ ) {
+        if (args[0] == args[i]) {
+          return false;
+        }
       }
-      else if ( input[pos] == '{' ) {
-        ++pos;
-        expected = Token::Category::PREFIX;
-        groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::SET);
-        groupStack.emplace(&groupStack.top().first->children.back(),"}");
-        continue;
+      return true;
+    },
+    Descriptor<double>{ .minArity = 1, .pure = true }
+  );
+
+  add(
+    std::string("at"), 
+    [](const std::vector<double>& args [[maybe_unused]]) -> double
+    {
+      throw std::runtime_error("LIMEX: at() not relevant for handle of type double");
+    },
+    Descriptor<double>{ .minArity = 2, .maxArity = 2, .pure = true }
+  );
+}
+
+// Built-in functions for collections of type Collection<double> are the same as for std::vector<double>
+template <>
+inline void Handle<double, Collection<double>>::initialize() {
+  for ( auto& callable : Handle<double>::getBuiltins().callables ) {
+    add(callable.name, callable.implementation, callable.descriptor);
+  }
+}
+
+/*******************************
+ ** Scheduler
+ *******************************/
+
+template <typename T, typename C>
+inline size_t Scheduler<T,C>::submit(const Expression<T,C>& expression, std::vector<T> variableValues, std::vector<C> collectionValues) {
+  auto evaluation = std::make_unique<Evaluation>(std::move(variableValues), std::move(collectionValues), std::nullopt);
+  evaluation->task.emplace( expression.evaluateAsync(*this, evaluation->variableValues, evaluation->collectionValues) );
+  evaluations.push_back(std::move(evaluation));
+  return evaluations.size() - 1;
+}
+
+template <typename T, typename C>
+inline void Scheduler<T,C>::run() {
+  for ( auto& evaluation : evaluations ) {
+    if ( !evaluation->task->done() ) {
+      evaluation->task->start();
+    }
+  }
+  while ( !pending.empty() ) {
+    // group pending calls by handle and callable, expressions of different handles may be submitted
+    std::vector<Call*> calls = std::move(pending);
+    pending.clear();
+    auto key = [](const Call* call) { return std::make_pair( (uintptr_t)call->handle, call->callable ); };
+    std::stable_sort(calls.begin(), calls.end(), [&key](const Call* lhs, const Call* rhs) { return key(lhs) < key(rhs); });
+    for ( size_t first = 0; first < calls.size(); ) {
+      size_t last = first;
+      std::vector< std::vector<T> > requests;
+      while ( last < calls.size() && key(calls[last]) == key(calls[first]) ) {
+        requests.push_back(std::move(calls[last]->arguments));
+        last++;
       }
-      else if ( input[pos] == '[' ) {
-        ++pos;
-        expected = Token::Category::PREFIX;
-        groupStack.top().first->children.emplace_back(Token::Category::OPERAND, Token::Type::SEQUENCE);
-        groupStack.emplace(&groupStack.top().first->children.back(),"]");
-        continue;
+      try {
+        auto results = calls[first]->handle->getCallable(calls[first]->callable).awaitable(requests);
+        bulkCalls++;
+        if ( results.size() != requests.size() ) {
+          throw std::runtime_error("LIMEX: Bulk implementation of '" + calls[first]->handle->getName(calls[first]->callable) + "' returned wrong number of results");
+        }
+        for ( size_t i = first; i < last; i++ ) {
+          calls[i]->result.emplace(std::move(results[i - first]));
+        }
       }
-      else {
-//std::cerr << "IF" << startsWith(input,pos,"if") << "/" << pos << std::endl;
-        throw std::runtime_error("LIMEX: Unexpected operand at: " + input.substr(0,pos) );
+      catch (...) {
+        for ( size_t i = first; i < last; i++ ) {
+          calls[i]->exception = std::current_exception();
+        }
       }
+      first = last;
+    }
+    // resume evaluations, which may add new pending calls
+    for ( auto call : calls ) {
+      call->continuation.resume();
     }
+  }
+}
 
-    if ( expected == Token::Category::POSTFIX ) {
-      // Consume postfix
-      std::string match = fetch(input, pos, postfix);
-      if ( !match.empty() ) {
-        pos += match.size();
-        groupStack.top().first->children.emplace_back(Token::Category::POSTFIX, Token::Type::OPERATOR, std::move(match));
-      }
-      expected = Token::Category::INFIX;
+template <typename T, typename C>
+inline T Scheduler<T,C>::get(size_t evaluation) {
+  if ( evaluation >= evaluations.size() || !evaluations[evaluation]->task->done() ) {
+    throw std::logic_error("LIMEX: Evaluation not completed");
+  }
+  return evaluations[evaluation]->task->get();
+}
+
+/*******************************
+ ** Registry
+ *******************************/
+
+template <typename T, typename C>
+inline const Expression<T,C>& Registry<T,C>::Rules::at(const std::string& name) const {
+  for ( size_t i = 0; i < names.size(); i++ ) {
+    if ( names[i] == name ) {
+      return *expressions[i];
     }
+  }
+  throw std::out_of_range("LIMEX: Unknown rule '" + name + "'");
+}
 
-    skipWhitespaces(input,pos);
-    if ( pos == input.length() ) break; 
+template <typename T, typename C>
+Registry<T,C>::Registry(const Handle<T,C>& handle)
+: handle(handle)
+, current(new Rules())
+{
+}
 
-    if ( startsWith(input,pos,groupStack.top().second) ) {
-      if ( groupStack.top().second == "then" ) {
-//std::cerr << " ... then ..." << std::endl;
-        auto match = groupStack.top().second;
-        // Consume closure of group and open next group
-        pos += match.size();
-        expected = Token::Category::PREFIX;
-        groupStack.pop();
-        groupStack.top().first->children.emplace_back(Token::Category::INFIX, Token::Type::GROUP, std::string(ternary[1]));
-        groupStack.emplace(&groupStack.top().first->children.back(), ternary[2]);
-        continue;
-      }
-      if ( groupStack.top().second == ":" || groupStack.top().second == ternary[2] ) {
-//std::cerr << " ... else ..." << std::endl;
-        auto match = groupStack.top().second;
-        // Consume closure of group
-        pos += groupStack.top().second.size();
-        expected = Token::Category::PREFIX;
-        groupStack.pop();
-        groupStack.top().first->children.emplace_back(Token::Category::INFIX, Token::Type::OPERATOR, std::string(match));
-        continue;
+template <typename T, typename C>
+Registry<T,C>::~Registry() {
+  delete current.load();
+}
+
+template <typename T, typename C>
+inline size_t Registry<T,C>::getStripe() {
+  static std::atomic<size_t> threads = 0;
+  thread_local size_t stripe = threads++ % STRIPES;
+  return stripe;
+}
+
+template <typename T, typename C>
+inline typename Registry<T,C>::Snapshot Registry<T,C>::acquire() const {
+  // register as reader before loading the current rules
+  auto counter = &stripes[getStripe()].readers[epoch.load() & 1];
+  counter->fetch_add(1);
+  return Snapshot(counter, current.load());
+}
+
+template <typename T, typename C>
+inline size_t Registry<T,C>::publish(const std::vector< std::pair<std::string,std::string> >& rules) {
+  // parse new rules off the evaluation path
+  auto next = std::make_unique<Rules>();
+  for ( auto& [name, input] : rules ) {
+    next->names.push_back(name);
+    next->expressions.push_back( std::make_unique< Expression<T,C> >(input, handle) );
+  }
+  std::lock_guard lock(publishing);
+  next->version = current.load()->version + 1;
+  size_t version = next->version;
+  const Rules* previous = current.exchange(next.release());
+  synchronize();
+  delete previous;
+  return version;
+}
+
+template <typename T, typename C>
+inline void Registry<T,C>::synchronize() {
+  // flip the epoch twice and wait until all readers registered with the previous parity are done
+  for ( size_t flip = 0; flip < 2; flip++ ) {
+    size_t parity = epoch.fetch_add(1) & 1;
+    for ( auto& stripe : stripes ) {
+      while ( stripe.readers[parity].load() != 0 ) {
+        std::this_thread::yield();
       }
-      // Consume closure of group
-      pos += groupStack.top().second.size();
-      expected = Token::Category::POSTFIX;
-      groupStack.pop();
-      continue;
     }
+  }
+}
 
-    if ( expected == Token::Category::INFIX ) {
-      // Consume separator
-      if ( input[pos] == ',' ) {
-        groupStack.top().first->children.emplace_back(Token::Category::INFIX, Token::Type::SEPARATOR, ",");
-        ++pos;
-        expected = Token::Category::PREFIX;
-        continue;
+/*******************************
+ ** Archive
+ *******************************/
+
+template <typename T, typename C>
+Archive<T,C>::Archive(const Handle<T,C>& handle, size_t budget)
+: handle(handle)
+, budget(budget)
+{
+}
+
+template <typename T, typename C>
+inline size_t Archive<T,C>::intern(const std::string& name) {
+  if ( auto it = ids.find(name); it != ids.end() ) {
+    return it->second;
+  }
+  statistics.encodedBytes += name.size();
+  names.push_back(name);
+  return ids[name] = names.size() - 1;
+}
+
+template <typename T, typename C>
+inline void Archive<T,C>::encode(std::vector<uint8_t>& bytes, uint64_t value) {
+  // seven bits per byte, highest bit indicates continuation
+  while ( value >= 0x80 ) {
+    bytes.push_back( (uint8_t)(value | 0x80) );
+    value >>= 7;
+  }
+  bytes.push_back( (uint8_t)value );
+}
+
+template <typename T, typename C>
+inline uint64_t Archive<T,C>::decode(const uint8_t*& position) {
+  uint64_t value = 0;
+  for ( unsigned int shift = 0; ; shift += 7 ) {
+    uint8_t byte = *position++;
+    value |= (uint64_t)(byte & 0x7F) << shift;
+    if ( !(byte & 0x80) ) return value;
+  }
+}
+
+template <typename T, typename C>
+inline void Archive<T,C>::encode(std::vector<uint8_t>& bytes, const Node<T,C>& node) {
+  enum Tag : uint8_t { NUMBER, INTEGER, INDEX, NODE, STRING };
+  encode(bytes, (uint64_t)node.type);
+  encode(bytes, node.operands.size());
+  for ( auto& operand : node.operands ) {
+    if ( std::holds_alternative<double>(operand) && node.quoted ) {
+      // strings are interned with the names, as codes depend on the handle
+      bytes.push_back(STRING);
+      encode(bytes, intern( handle.getString( (size_t)std::get<double>(operand) ) ));
+    }
+    else if ( std::holds_alternative<double>(operand) ) {
+      double value = std::get<double>(operand);
+      if ( value >= 0 && value < 0x1p53 && value == std::floor(value) && !std::signbit(value) ) {
+        // non-negative integral numbers are encoded as variable-length integers
+        bytes.push_back(INTEGER);
+        encode(bytes, (uint64_t)value);
       }
-      
-      // Consume ternary
-      if ( input[pos] == '?' ) {
-//std::cerr << "TERNARY" << std::endl;
-        ++pos;
-        expected = Token::Category::PREFIX;
-        groupStack.top().first->children.emplace_back(Token::Category::INFIX, Token::Type::GROUP, "?");
-        groupStack.emplace(&groupStack.top().first->children.back(), ":");
-        continue;
+      else {
+        bytes.push_back(NUMBER);
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(double));
+        for ( size_t i = 0; i < sizeof(double); i++ ) {
+          bytes.push_back( (uint8_t)(bits >> (8*i)) );
+        }
       }
-      // Consume infix
-      std::string match = fetch(input, pos, infix);
-      if ( !match.empty() ) {
-        pos += match.size();
-        groupStack.top().first->children.emplace_back(Token::Category::INFIX, Token::Type::OPERATOR, std::move(match));
-        expected = Token::Category::PREFIX;
-        continue;
+    }
+    else if ( std::holds_alternative<size_t>(operand) ) {
+      bytes.push_back(INDEX);
+      encode(bytes, std::get<size_t>(operand));
+    }
+    else {
+      bytes.push_back(NODE);
+      encode(bytes, std::get< Node<T,C> >(operand));
+    }
+  }
+}
+
+template <typename T, typename C>
+inline Node<T,C> Archive<T,C>::decode(Expression<T,C>* expression, const uint8_t*& position) const {
+  enum Tag : uint8_t { NUMBER, INTEGER, INDEX, NODE, STRING };
+  auto type = (Type)decode(position);
+  size_t count = decode(position);
+  std::vector< std::variant< double, size_t, Node<T,C> > > operands;
+  operands.reserve(count);
+  bool quoted = false;
+  for ( size_t i = 0; i < count; i++ ) {
+    switch ( *position++ ) {
+      case NUMBER: {
+        uint64_t bits = 0;
+        for ( size_t i = 0; i < sizeof(double); i++ ) {
+          bits |= (uint64_t)(*position++) << (8*i);
+        }
+        double value;
+        std::memcpy(&value, &bits, sizeof(double));
+        operands.emplace_back(value);
+        break;
       }
+      case INTEGER:
+        operands.emplace_back( (double)decode(position) );
+        break;
+      case INDEX:
+        operands.emplace_back( (size_t)decode(position) );
+        break;
+      case NODE:
+        operands.emplace_back( decode(expression, position) );
+        break;
+      case STRING:
+        operands.emplace_back( (double)handle.intern( names.at(decode(position)) ) );
+        quoted = true;
+        break;
+      default:
+        throw std::logic_error("LIMEX: Corrupt encoding of expression");
     }
+  }
+  Node<T,C> node(expression, type, std::move(operands));
+  node.quoted = quoted;
+  return node;
+}
 
-    // Invalid character
-    throw std::runtime_error("LIMEX: Unexpected character: " + input.substr(0,pos));
+template <typename T, typename C>
+inline size_t Archive<T,C>::add(const Expression<T,C>& expression) {
+  std::lock_guard lock(mutex);
+  std::vector<uint8_t> bytes;
+  // header with interned names
+  encode(bytes, expression.getVariables().size());
+  for ( auto& name : expression.getVariables() ) {
+    encode(bytes, intern(name));
   }
-  if (groupStack.size() != 1) {
-    throw std::runtime_error("LIMEX: Unbalanced parentheses, brackets, or braces:" + input.substr(0,pos));
+  encode(bytes, expression.getCollections().size());
+  for ( auto& name : expression.getCollections() ) {
+    encode(bytes, intern(name));
   }
-  return root;
+  encode(bytes, expression.getTarget().has_value() ? intern(expression.getTarget().value()) + 1 : 0);
+  encode(bytes, expression.getRoot());
+  bytes.shrink_to_fit();
+  statistics.encodedBytes += bytes.size();
+  records.push_back(std::move(bytes));
+  return records.size() - 1;
 }
 
 template <typename T, typename C>
-inline size_t Expression<T,C>::skipWhitespaces(const std::string& input, size_t& pos) {
-  // Skip whitespaces
-  while ( pos < input.length() && std::isspace( input[pos] ) ) {
-    ++pos;     
+inline std::shared_ptr<const Expression<T,C>> Archive<T,C>::get(size_t id) {
+  std::lock_guard lock(mutex);
+  if ( auto it = cache.find(id); it != cache.end() ) {
+    // move to front of recently used expressions
+    statistics.hits++;
+    recent.splice(recent.begin(), recent, it->second.position);
+    return it->second.expression;
   }
-  return pos;
+  if ( id >= records.size() ) {
+    throw std::out_of_range("LIMEX: Unknown expression in archive");
+  }
+  statistics.misses++;
+  const uint8_t* position = records[id].data();
+  std::vector<std::string> variables(decode(position));
+  for ( auto& name : variables ) {
+    name = names[decode(position)];
+  }
+  std::vector<std::string> collections(decode(position));
+  for ( auto& name : collections ) {
+    name = names[decode(position)];
+  }
+  std::optional<std::string> target;
+  if ( size_t name = decode(position) ) {
+    target = names[name - 1];
+  }
+  auto expression = std::shared_ptr<const Expression<T,C>>( 
+    new Expression<T,C>(handle, std::move(variables), std::move(collections), std::move(target), [&](Expression<T,C>* expression) { return decode(expression, position); })
+  );
+  size_t bytes = sizeof(Expression<T,C>) + estimate(expression->getRoot());
+  recent.push_front(id);
+  cache.emplace(id, Entry{ expression, recent.begin(), bytes });
+  statistics.inflatedBytes += bytes;
+  evict();
+  return expression;
+}
+
+template <typename T, typename C>
+inline void Archive<T,C>::evict() {
+  // keep at least the most recently used expression
+  while ( statistics.inflatedBytes > budget && recent.size() > 1 ) {
+    auto it = cache.find(recent.back());
+    statistics.inflatedBytes -= it->second.bytes;
+    statistics.evictions++;
+    cache.erase(it);
+    recent.pop_back();
+  }
+}
+
+template <typename T, typename C>
+inline void Archive<T,C>::setBudget(size_t bytes) {
+  std::lock_guard lock(mutex);
+  budget = bytes;
+  evict();
+}
+
+template <typename T, typename C>
+inline typename Archive<T,C>::Statistics Archive<T,C>::getStatistics() const {
+  std::lock_guard lock(mutex);
+  return statistics;
 }
 
 template <typename T, typename C>
-inline bool Expression<T,C>::startsWith(const std::string& input, size_t start, std::string_view candidate) {
-  if ( input.compare(start, candidate.size(), candidate) == 0 ) {
-    // `input` at `start` begins with candidate
-    if ( !isalphanumeric( candidate.back() ) ) {
-//std::cerr << "Found " << candidate << " after " << input.substr(0,start) << std::endl;
-      return true;
-    }
-    if ( start + candidate.size() == input.size() || !isalphanumeric( input[start + candidate.size()] ) ) {
-//std::cerr << "Found " << candidate << " after " << input.substr(0,start) << std::endl;
-      return true;
+inline size_t Archive<T,C>::estimate(const Node<T,C>& node) {
+  size_t bytes = sizeof(Node<T,C>) + node.operands.capacity() * sizeof(std::variant< double, size_t, Node<T,C> >);
+  for ( auto& operand : node.operands ) {
+    if ( std::holds_alternative< Node<T,C> >(operand) ) {
+      // nested nodes are already counted as operands
+      bytes += estimate(std::get< Node<T,C> >(operand)) - sizeof(Node<T,C>);
     }
   }
-  return false;
+  return bytes;
 }
 
+/*******************************
+ ** Sampler
+ *******************************/
 
 template <typename T, typename C>
-template <size_t N>
-inline std::string Expression<T,C>::fetch(const std::string& input, size_t start, const std::array<std::string_view, N>& prefix) {
-  for (const auto& candidate : prefix) {
-    if ( startsWith(input,start,candidate) ) {
-      return std::string(candidate);
-    }
-  }
-  return ""; // No match found
+Sampler<T,C>::Sampler(std::chrono::nanoseconds threshold, size_t capacity, size_t timings)
+: threshold(threshold)
+, timings(timings)
+, slots(std::max<size_t>(capacity,1))
+{
 }
 
 template <typename T, typename C>
-inline size_t Expression<T,C>::getIndex(std::vector<std::string>& container, std::string name) {
-  for ( size_t i = 0; i < container.size(); i++) {
-    if ( container[i] == name ) {
-      return i;
+inline void Sampler<T,C>::record( const Expression<T,C>& expression, std::chrono::nanoseconds duration, const std::vector<T>& variableValues, const std::vector<C>& collectionValues ) {
+  uint64_t sequence = next.fetch_add(1, std::memory_order_relaxed);
+  auto& slot = slots[sequence % slots.size()];
+  if ( slot.busy.exchange(true, std::memory_order_acquire) ) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Sample sample{ expression.input, duration, {}, {}, {} };
+  if ( sample.input.empty() ) {
+    // built and archived expressions have no input
+    try {
+      sample.input = expression.serialize();
+    }
+    catch ( const std::exception& ) {
+      // expressions with non-finite literals have no infix notation
+      sample.input = expression.serialize(Notation::AST);
     }
   }
-  container.push_back(name);
-  return container.size()-1;
-}
- 
-template <typename T, typename C>
-inline Node<T,C> Expression<T,C>::buildTree( Type type, const std::vector<Token>& tokens, std::optional<size_t> index ) {
-  std::vector< std::variant< double, size_t, Node<T,C> > > operands;
-  if ( index.has_value() ) {
-    operands.emplace_back( index.value() );
+  auto& variables = expression.getVariables();
+  for ( size_t i = 0; i < variables.size() && i < variableValues.size(); i++ ) {
+    sample.variables.emplace_back(variables[i], variableValues[i]);
+  }
+  auto& collections = expression.getCollections();
+  for ( size_t i = 0; i < collections.size() && i < collectionValues.size(); i++ ) {
+    if constexpr ( requires { collectionValues[i].size(); } ) {
+      sample.collections.emplace_back(collections[i], collectionValues[i].size());
+    }
   }
 
-  std::stack< Node<T,C> > nodeStack;
-  std::stack< Type > operatorStack;
-
-  auto createNode = [&](const Token& token) {
-    switch (token.type) {
-      case Token::Type::NUMBER:
-        return Node<T,C>(this, std::stod(token.value));
-      case Token::Type::VARIABLE:
-        return Node<T,C>(this, Type::variable, token.value);
-      case Token::Type::COLLECTION:
-        return Node<T,C>(this, Type::collection, token.value);
-      case Token::Type::GROUP:
-        return buildTree(Type::group, token.children);
-      case Token::Type::SET:
-        return buildTree(Type::set, token.children);    
-      case Token::Type::SEQUENCE:
-        return buildTree(Type::sequence, token.children);    
-      case Token::Type::FUNCTION_CALL:
-        return buildTree(Type::function_call, token.children, handle.getIndex(token.value));    
-      case Token::Type::AGGREGATION:
-        return buildTree(Type::aggregation, token.children, handle.getIndex(token.value));    
-      case Token::Type::INDEXED_VARIABLE:
-        if constexpr (std::is_same_v< C, std::vector<T> >) {
-          return buildTree(Type::index, token.children, getIndex(collections,token.value));
+  auto& root = expression.getRoot();
+  if ( timings && root.isPure() ) {
+    // evaluate the operations below the slowest operation of the previous level again, so that the hot path 
+    // is found with a number of evaluations proportional to the depth of the tree
+    struct Measurement {
+      const Node<T,C>* node;
+      size_t depth;
+      std::chrono::nanoseconds duration;
+    };
+    std::vector<Measurement> measurements;
+    std::vector< std::pair<const Node<T,C>*, size_t> > level;
+    auto expand = [&level](const Node<T,C>& parent, size_t parentDepth) {
+      std::vector< std::pair<const Node<T,C>*, size_t> > pending = { { &parent, parentDepth } };
+      while ( !pending.empty() ) {
+        auto [node, depth] = pending.back();
+        pending.pop_back();
+        for ( auto& operand : node->operands ) {
+          if ( !std::holds_alternative< Node<T,C> >(operand) ) {
+            continue;
+          }
+          auto& child = std::get< Node<T,C> >(operand);
+          if ( child.type == Type::group || child.type == Type::set || child.type == Type::sequence ) {
+            // operations within groups, sets, and sequences belong to the same level
+            pending.emplace_back( &child, depth + 1 );
+          }
+          else if ( child.type != Type::literal && child.type != Type::variable && child.type != Type::collection ) {
+            level.emplace_back( &child, depth + 1 );
+          }
         }
-        else if constexpr (std::is_same_v< C, T >) {
-          std::vector<Token> children;
-          children.emplace_back(Token::Category::OPERAND, Token::Type::COLLECTION, token.value);
-          children.emplace_back(Token::Category::INFIX, Token::Type::SEPARATOR, ",");
-          children.insert(children.end(), token.children.begin(), token.children.end());
-          return buildTree(Type::function_call, children, handle.getIndex("at"));
+      }
+    };
+    expand(root, 0);
+    while ( !level.empty() ) {
+      size_t slowest = measurements.size();
+      for ( auto [node, depth] : level ) {
+        auto start = std::chrono::steady_clock::now();
+        try {
+          node->evaluate(variableValues,collectionValues);
         }
-        else {
-          throw std::logic_error("LIMEX:Collection type not supported");
+        catch (...) {
+          // the duration until the error is raised is reported
         }
-      default:
-        throw std::logic_error("LIMEX: Unexpected token type for operand");
-    }
-  };
-
-  auto applyOperator = [&](Type operatorType) {
-    // process ternary operator
-    if ( operatorType == Type::_else ) {
-      if ( operatorStack.size() < 2) {
-        throw std::logic_error("LIMEX: Insufficient operators for ternary operator");
-      }
-      operatorStack.pop();
-      if ( operatorStack.top() != Type::_then_ ) {
-        throw std::logic_error("LIMEX: Wrong operators for ternary operator");
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        if ( slowest < measurements.size() && measurements[slowest].duration < elapsed ) {
+          slowest = measurements.size();
+        }
+        measurements.push_back({ node, depth, elapsed });
       }
-      if (nodeStack.size() < 3) {
-        throw std::logic_error("LIMEX: Insufficient operands for ternary operator");
+      auto& hot = measurements[slowest];
+      level.clear();
+      expand(*hot.node, hot.depth);
+    }
+    std::ranges::stable_sort(measurements, std::ranges::greater(), &Measurement::duration);
+    if ( measurements.size() > timings ) {
+      measurements.erase(measurements.begin() + timings, measurements.end());
+    }
+    for ( auto& measurement : measurements ) {
+      std::string subexpression;
+      try {
+        measurement.node->serialize(subexpression, Notation::INFIX);
       }
-      // Pop three operands and apply the operator
-      Node<T,C> else_result = std::move(nodeStack.top());
-      nodeStack.pop();
-      Node<T,C> then_result = std::move(nodeStack.top());
-      then_result.type = Type::group;
-      nodeStack.pop();
-      Node<T,C> condition = std::move(nodeStack.top());
-      if ( condition.type == Type::if_ ) {
-        condition.type = Type::group;
+      catch ( const std::exception& ) {
+        // subexpressions with non-finite literals have no infix notation
+        subexpression.clear();
+        measurement.node->serialize(subexpression, Notation::AST);
       }
-      nodeStack.pop();
+      sample.timings.push_back({ std::move(subexpression), measurement.depth, measurement.duration });
+    }
+  }
 
-      nodeStack.push(Node<T,C>(this,Type::if_then_else, {std::move(condition), std::move(then_result), std::move(else_result) }));
-      return;
+  slot.sequence = sequence;
+  slot.sample = std::move(sample);
+  slot.busy.store(false, std::memory_order_release);
+}
+
+template <typename T, typename C>
+inline std::vector<typename Sampler<T,C>::Sample> Sampler<T,C>::dump() {
+  std::vector< std::pair<uint64_t, Sample> > samples;
+  for ( auto& slot : slots ) {
+    while ( slot.busy.exchange(true, std::memory_order_acquire) ) {
+      // wait for the writer of the slot
+      std::this_thread::yield();
     }
+    if ( slot.sample ) {
+      samples.emplace_back( slot.sequence, std::move(slot.sample.value()) );
+      slot.sample.reset();
+    }
+    slot.busy.store(false, std::memory_order_release);
+  }
+  std::ranges::sort(samples, {}, &std::pair<uint64_t, Sample>::first);
+  std::vector<Sample> result;
+  for ( auto& [sequence, sample] : samples ) {
+    result.push_back(std::move(sample));
+  }
+  return result;
+}
 
-    // process all types of assignments
-    if ( (int)operatorType >= (int)Type::assign ) {
-      if (nodeStack.size() < 2) {
-        throw std::runtime_error("LIMEX: Insufficient operands for assignment");
-      }
-      Node<T,C> right = std::move(nodeStack.top());
-      nodeStack.pop();
-      Node<T,C> left = std::move(nodeStack.top());
-      nodeStack.pop();
-      if ( left.type != Type::variable ) {
-        throw std::runtime_error("LIMEX: illegal target for assignment");
-      }
-      if ( operatorType == Type::assign ) {
-        nodeStack.push(Node<T,C>(this,Type::assign, {std::move(right) }));
+/*******************************
+ ** Budget
+ *******************************/
+
+inline Budget::Budget(Clock::time_point deadline, std::stop_token token, size_t interval)
+: deadline(deadline)
+, token(std::move(token))
+, interval(std::max<size_t>(interval,1))
+, previous(current)
+{
+  current = this;
+}
+
+inline void Budget::charge(size_t work) {
+  if ( !current ) [[likely]] {
+    return;
+  }
+  if ( work < current->remaining ) {
+    current->remaining -= work;
+    return;
+  }
+  current->check();
+}
+
+inline void Budget::check() {
+  remaining = interval;
+  if ( token.stop_requested() ) {
+    throw Cancelled("LIMEX: Evaluation cancelled");
+  }
+  if ( deadline != Clock::time_point::max() && Clock::now() >= deadline ) {
+    throw Cancelled("LIMEX: Deadline exceeded");
+  }
+}
+
+/*******************************
+ ** Pool
+ *******************************/
+
+inline Pool::Pool(size_t size)
+: cpus(discover())
+, statistics(std::max<size_t>(size,1))
+{
+  for ( size_t worker = 0; worker < statistics.size(); worker++ ) {
+    workers.emplace_back(&Pool::work, this, worker);
+#if defined(__linux__)
+    if ( cpus.size() > 1 && !cpus[getNode(worker)].empty() ) {
+      // pin worker to the CPUs of its NUMA node
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for ( int cpu : cpus[getNode(worker)] ) {
+        CPU_SET(cpu, &set);
       }
-      else {
-        // add_assign, subtract_assign, multiply_assign, or divide_assign
-        nodeStack.push(Node<T,C>(this,operatorType, {std::move(left), std::move(right) }));
+      pthread_setaffinity_np(workers.back().native_handle(), sizeof(cpu_set_t), &set);
+    }
+#endif
+  }
+}
+
+inline Pool::~Pool() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  started.notify_all();
+  for ( auto& worker : workers ) {
+    worker.join();
+  }
+}
+
+inline std::vector< std::vector<int> > Pool::discover() {
+  std::vector< std::vector<int> > nodes;
+#if defined(__linux__)
+  // parse lists like "0-3,8-11" provided for each NUMA node
+  for ( size_t node = 0; ; node++ ) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if ( !file || !std::getline(file, list) ) break;
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while ( pos < list.size() ) {
+      size_t end = list.find(',', pos);
+      if ( end == std::string::npos ) end = list.size();
+      std::string range = list.substr(pos, end - pos);
+      size_t dash = range.find('-');
+      if ( !range.empty() ) {
+        int first = std::stoi(range.substr(0,dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for ( int cpu = first; cpu <= last; cpu++ ) {
+          cpus.push_back(cpu);
+        }
       }
-      return;
+      pos = end + 1;
     }
+    nodes.push_back(std::move(cpus));
+  }
+#endif
+  if ( nodes.empty() ) {
+    // single node without pinning
+    nodes.emplace_back();
+  }
+  return nodes;
+}
 
-    if (nodeStack.size() < 2) {
-      throw std::logic_error("LIMEX: Insufficient operands for infix operator");
+inline std::pair<size_t,size_t> Pool::getRange(size_t worker, size_t rows) const {
+  size_t chunk = rows / workers.size();
+  size_t remainder = rows % workers.size();
+  size_t begin = worker * chunk + std::min(worker, remainder);
+  return { begin, begin + chunk + (worker < remainder ? 1 : 0) };
+}
+
+inline void Pool::run(const std::function<void(size_t worker)>& task) {
+  if ( owner == this ) {
+    // the calling worker would wait for itself
+    throw std::logic_error("LIMEX: Pool cannot run tasks from within its own task");
+  }
+  std::lock_guard serialized(running);
+  std::unique_lock lock(mutex);
+  this->task = &task;
+  exception = nullptr;
+  pending = workers.size();
+  generation++;
+  started.notify_all();
+  finished.wait(lock, [this] { return pending == 0; });
+  this->task = nullptr;
+  if ( exception ) {
+    std::rethrow_exception(exception);
+  }
+}
+
+inline void Pool::work(size_t worker) {
+  owner = this;
+  size_t done = 0;
+  while ( true ) {
+    const std::function<void(size_t)>* current;
+    {
+      std::unique_lock lock(mutex);
+      started.wait(lock, [&] { return stopping || generation != done; });
+      if ( stopping ) return;
+      done = generation;
+      current = task;
     }
-    // Pop two operands and apply the operator
-    Node<T,C> right = std::move(nodeStack.top());
-    nodeStack.pop();
-    Node<T,C> left = std::move(nodeStack.top());
-    nodeStack.pop();
+    std::exception_ptr error;
+    try {
+      (*current)(worker);
+    }
+    catch (...) {
+      error = std::current_exception();
+    }
+    std::lock_guard lock(mutex);
+    if ( error && !exception ) {
+      exception = error;
+    }
+    if ( --pending == 0 ) {
+      finished.notify_one();
+    }
+  }
+}
 
-    nodeStack.push(Node<T,C>(this,operatorType, {std::move(left), std::move(right)}));
-    return;
-  };
+inline void Pool::record(size_t worker, size_t rows, std::chrono::nanoseconds duration) {
+  // each worker only updates its own entry
+  statistics[worker].rows += rows;
+  statistics[worker].duration += duration;
+}
 
-  for ( size_t i = 0; i < tokens.size(); i++ ) {
-//std::cerr << "Token: '" << tokens[i].value << "', " << (i+1) << "/" << tokens.size() << std::endl;
-    if ( tokens[i].category == Token::Category::PREFIX && tokens[i].type == Token::Type::GROUP ) {
-      // keyword "if" starts a group, other prefix operators are treated separately
-      auto node = buildTree(Type::if_ , tokens[i].children); 
-      nodeStack.push(std::move(node));
-      continue;
+inline std::vector<Pool::Statistics> Pool::getStatistics() const {
+  std::vector<Statistics> result(cpus.size());
+  for ( size_t worker = 0; worker < statistics.size(); worker++ ) {
+    result[getNode(worker)].rows += statistics[worker].rows;
+    result[getNode(worker)].duration += statistics[worker].duration;
+  }
+  return result;
+}
+
+inline void Pool::resetStatistics() {
+  std::fill(statistics.begin(), statistics.end(), Statistics());
+}
+
+#ifdef LIMEX_METRICS
+/*******************************
+ ** Metrics
+ *******************************/
+
+inline void Metrics::increment(uint64_t& counter, uint64_t value) {
+  // only the owning thread writes, other threads may read concurrently
+  std::atomic_ref<uint64_t> reference(counter);
+  reference.store(reference.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline uint64_t Metrics::load(const uint64_t& counter) {
+  return std::atomic_ref<uint64_t>(const_cast<uint64_t&>(counter)).load(std::memory_order_relaxed);
+}
+
+inline size_t Metrics::Histogram::bucket(uint64_t value) {
+  if ( value < SUB_BUCKETS ) {
+    return value;
+  }
+  // values in [2^e, 2^(e+1)) are split into SUB_BUCKETS buckets of equal width
+  size_t exponent = std::bit_width(value) - 1;
+  return ( exponent - 2 ) * SUB_BUCKETS + ( ( value >> ( exponent - 3 ) ) & ( SUB_BUCKETS - 1 ) );
+}
+
+inline uint64_t Metrics::Histogram::upper(size_t bucket) {
+  if ( bucket < SUB_BUCKETS ) {
+    return bucket;
+  }
+  size_t exponent = bucket / SUB_BUCKETS + 2;
+  uint64_t lower = ( SUB_BUCKETS + bucket % SUB_BUCKETS ) << ( exponent - 3 );
+  return lower + ( (uint64_t)1 << ( exponent - 3 ) ) - 1;
+}
+
+inline void Metrics::Histogram::record(uint64_t value) {
+  increment(counts[bucket(value)]);
+}
+
+inline void Metrics::Histogram::merge(const Histogram& other) {
+  for ( size_t i = 0; i < BUCKETS; i++ ) {
+    counts[i] += load(other.counts[i]);
+  }
+}
+
+inline void Metrics::Histogram::reset() {
+  for ( auto& count : counts ) {
+    std::atomic_ref<uint64_t>(count).store(0, std::memory_order_relaxed);
+  }
+}
+
+inline uint64_t Metrics::Histogram::getCount() const {
+  uint64_t count = 0;
+  for ( auto value : counts ) {
+    count += value;
+  }
+  return count;
+}
+
+inline uint64_t Metrics::Histogram::getPercentile(double percentile) const {
+  uint64_t count = getCount();
+  if ( count == 0 ) {
+    return 0;
+  }
+  auto rank = (uint64_t)std::ceil( std::clamp(percentile, 0.0, 100.0) / 100 * count );
+  uint64_t seen = 0;
+  for ( size_t i = 0; i < BUCKETS; i++ ) {
+    seen += counts[i];
+    if ( seen >= std::max<uint64_t>(rank,1) ) {
+      return upper(i);
     }
-    if ( tokens[i].category == Token::Category::INFIX && tokens[i].type == Token::Type::GROUP ) {
-      // operators '?' and keyword "then" start a group, other infix operators are treated separately
-      auto node = buildTree(Type::_then_ , tokens[i].children); 
-      nodeStack.push(std::move(node));
-      operatorStack.push(Type::_then_);
-      continue;
+  }
+  return upper(BUCKETS - 1);
+}
+
+inline std::vector< std::pair<uint64_t,uint64_t> > Metrics::Histogram::getBuckets() const {
+  std::vector< std::pair<uint64_t,uint64_t> > buckets;
+  for ( size_t i = 0; i < BUCKETS; i++ ) {
+    if ( counts[i] ) {
+      buckets.emplace_back(upper(i), counts[i]);
     }
-    if ( tokens[i].category == Token::Category::OPERAND ) {
-      auto node = createNode( tokens[i] );
-      // apply postfix and prefix operators
-      if ( i + 1 < tokens.size() && tokens[i+1].category == Token::Category::POSTFIX ) {
-        node = Node<T,C>(this, postfixTypes.at(tokens[i+1].value), { std::move(node) });
-      }
-      if ( i > 0 && tokens[i-1].category == Token::Category::PREFIX ) {
-        node = Node<T,C>(this, prefixTypes.at(tokens[i-1].value), { std::move(node) });
-      }
-      nodeStack.push(std::move(node));
+  }
+  return buckets;
+}
+
+inline Metrics::Local& Metrics::local() {
+  thread_local std::shared_ptr<Local> instance = [] {
+    // metrics of the thread remain available after the thread has ended
+    auto instance = std::make_shared<Local>();
+    std::lock_guard lock(mutex);
+    locals.push_back(instance);
+    return instance;
+  }();
+  return *instance;
+}
+
+inline void Metrics::enable(size_t samplingPeriod, size_t expressions) {
+  Metrics::samplingPeriod.store(std::max<size_t>(samplingPeriod,1), std::memory_order_relaxed);
+  expressionLimit.store(expressions, std::memory_order_relaxed);
+  enabled.store(true, std::memory_order_relaxed);
+}
+
+inline Metrics::Category Metrics::categorize(const std::exception& exception) {
+  if ( dynamic_cast<const Cancelled*>(&exception) ) {
+    return Category::CANCELLED;
+  }
+  std::string_view message = exception.what();
+  if ( message.find("Division by zero") != std::string_view::npos ) {
+    return Category::DIVISION_BY_ZERO;
+  }
+  if ( message.find("Illegal index") != std::string_view::npos ) {
+    return Category::ILLEGAL_INDEX;
+  }
+  if ( message.find("Insufficient") != std::string_view::npos ) {
+    return Category::MISSING_VALUES;
+  }
+  return Category::OTHER;
+}
+
+inline void Metrics::recordParse(std::chrono::nanoseconds duration) {
+  auto& metrics = local();
+  increment(metrics.parses);
+  metrics.parseDuration.record( (uint64_t)duration.count() );
+}
+
+template <typename F>
+inline void Metrics::measureBatch(size_t rows, F&& evaluate) {
+  auto& metrics = local();
+  increment(metrics.batches);
+  increment(metrics.rows, rows);
+  try {
+    evaluate();
+  }
+  catch ( const std::exception& exception ) {
+    recordError( categorize(exception) );
+    throw;
+  }
+}
+
+template <typename E, typename F>
+inline auto Metrics::measure(const E& expression, F&& evaluate) {
+  auto& metrics = local();
+  increment(metrics.evaluations);
+  if ( --metrics.countdown ) {
+    try {
+      return evaluate();
     }
-    else if ( tokens[i].type == Token::Type::SEPARATOR ) {
-      // separators create separate operand nodes
-      // clear stack and apply all operators on stack
-      while ( !operatorStack.empty() ) {
-        applyOperator(operatorStack.top());
-        operatorStack.pop();
-      }
-      if (nodeStack.size() != 1) {
-        throw std::runtime_error("LIMEX: Invalid expression - unmatched operators or operands");
-      }
-      operands.emplace_back( std::move(nodeStack.top()) );
-      nodeStack.pop();
-      continue;
+    catch ( const std::exception& exception ) {
+      recordError( categorize(exception) );
+      throw;
     }
-    else if ( tokens[i].category == Token::Category::INFIX ) {
-      Type operatorType = infixTypes.at(tokens[i].value);
-      if ( (int)operatorType >= (int)Type::assign ) {
-        if ( i != 1 ) {
-          throw std::runtime_error("LIMEX: Assignment must start with a variable followed by the assignment operator");
+  }
+  metrics.countdown = samplingPeriod.load(std::memory_order_relaxed);
+  auto start = std::chrono::steady_clock::now();
+  try {
+    auto result = evaluate();
+    auto duration = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    metrics.evaluationDuration.record(duration);
+    if ( size_t limit = expressionLimit.load(std::memory_order_relaxed) ) {
+      // expressions are identified by their structure, as built expressions have no input
+      uint64_t hash = expression.structure.load(std::memory_order_relaxed);
+      std::lock_guard lock(metrics.mutex);
+      if ( !hash && metrics.expressions.size() < limit ) {
+        // the hash is determined once per expression and not at all once the table is full
+        hash = expression.hash();
+        expression.structure.store(hash, std::memory_order_relaxed);
+      }
+      auto it = hash ? metrics.expressions.find(hash) : metrics.expressions.end();
+      if ( hash && it == metrics.expressions.end() && metrics.expressions.size() < limit ) {
+        Profile profile;
+        try {
+          profile.expression = expression.input.empty() ? expression.serialize() : expression.input;
         }
-        if ( operatorType == Type::assign ) {
-          // remove target from the list of variables 
-          variables.clear();
+        catch ( const std::exception& ) {
+          // expressions with non-finite literals have no infix notation
         }
-        target = tokens[0].value;
+        it = metrics.expressions.emplace(hash, std::move(profile)).first;
       }
-      // apply operators on stack with smaller or equal precedence number
-      while ( 
-       !operatorStack.empty() && 
-       precedences.at(operatorStack.top()) <= precedences.at(operatorType) && 
-       operatorStack.top() != Type::_then_ 
-     ) {
-//std::cerr << "apply prior operator: " << (int)operatorStack.top() << "/" << (int)Type::if_then_else << std::endl;
-        applyOperator(operatorStack.top());
-        operatorStack.pop();
+      if ( it != metrics.expressions.end() ) {
+        it->second.duration.record(duration);
       }
-//std::cerr << "add operator: " << (int)operatorType << "/" << (int)Type::if_then_else << std::endl;
-      operatorStack.push(operatorType);
     }
-    // skip prefix and postfix tokens
+    return result;
   }
-
-  // apply all operators on stack
-//std::cerr << "flush" << std::endl;
-  while ( !operatorStack.empty() ) {
-    applyOperator(operatorStack.top());
-    operatorStack.pop();
+  catch ( const std::exception& exception ) {
+    recordError( categorize(exception) );
+    throw;
   }
+}
 
-  if (nodeStack.size() != 1) {
-    throw std::logic_error("LIMEX: Invalid expression - unmatched operators or operands");
+inline Metrics::Snapshot Metrics::snapshot() {
+  Snapshot snapshot;
+  std::lock_guard lock(mutex);
+  for ( auto& metrics : locals ) {
+    snapshot.parses += load(metrics->parses);
+    snapshot.evaluations += load(metrics->evaluations);
+    snapshot.batches += load(metrics->batches);
+    snapshot.rows += load(metrics->rows);
+    for ( size_t i = 0; i < snapshot.errors.size(); i++ ) {
+      snapshot.errors[i] += load(metrics->errors[i]);
+    }
+    snapshot.parseDuration.merge(metrics->parseDuration);
+    snapshot.evaluationDuration.merge(metrics->evaluationDuration);
+    snapshot.aggregationSize.merge(metrics->aggregationSize);
+    std::lock_guard expressionsLock(metrics->mutex);
+    for ( auto& [hash, profile] : metrics->expressions ) {
+      auto& merged = snapshot.expressions[hash];
+      merged.expression = profile.expression;
+      merged.duration.merge(profile.duration);
+    }
   }
-
-  operands.emplace_back( std::move(nodeStack.top()) );
-  return Node<T,C>(this, type, operands);
+  return snapshot;
 }
 
-template <typename T, typename C>
-inline std::string Expression<T,C>::stringify() const {
-  return root.stringify();
+inline void Metrics::reset() {
+  std::lock_guard lock(mutex);
+  auto zero = [](uint64_t& counter) { std::atomic_ref<uint64_t>(counter).store(0, std::memory_order_relaxed); };
+  for ( auto& metrics : locals ) {
+    zero(metrics->parses);
+    zero(metrics->evaluations);
+    zero(metrics->batches);
+    zero(metrics->rows);
+    for ( auto& errors : metrics->errors ) {
+      zero(errors);
+    }
+    metrics->parseDuration.reset();
+    metrics->evaluationDuration.reset();
+    metrics->aggregationSize.reset();
+    std::lock_guard expressionsLock(metrics->mutex);
+    metrics->expressions.clear();
+  }
 }
+#endif
 
 /*******************************
- ** Handle
+ ** Builder
  *******************************/
 
 template <typename T, typename C>
-inline size_t Handle<T,C>::getIndex(const std::string& name) const {
-  for ( size_t i = 0; i < names.size(); i++) {
-    if ( names[i] == name ) {
-      return i;
-    }
+inline size_t Builder<T,C>::getIndex(std::vector<std::string>& container, const std::string& name) {
+  auto it = std::find(container.begin(), container.end(), name);
+  if ( it != container.end() ) {
+    return (size_t)std::distance(container.begin(), it);
   }
-  throw std::logic_error("LIMEX: Unknown callable '" + name + "'");
+  container.push_back(name);
+  return container.size() - 1;
 }
 
 template <typename T, typename C>
-inline void Handle<T,C>::add(const std::string& name, std::function<T(const std::vector<T>&)> implementation) {
-  if (std::ranges::find(names, name) != names.end()) {
-    throw std::runtime_error("LIMEX: Callable with name '" + name + "' already exists");
+inline typename Builder<T,C>::Operands Builder<T,C>::toOperands(std::vector<Term>& terms, std::optional<size_t> index) {
+  Operands operands;
+  operands.reserve(terms.size() + 1);
+  if ( index.has_value() ) {
+    operands.emplace_back( index.value() );
   }
-  names.push_back(name);
-  implementations.emplace_back(std::move(implementation));
+  for ( auto& term : terms ) {
+    if ( term.type == Type::collection && !index.has_value() ) {
+      throw std::logic_error("LIMEX: Collections can only be used as argument of callables");
+    }
+    if ( term.type == Type::set ) {
+      throw std::logic_error("LIMEX: Sets can only be used as right operand of '∈' and '∉'");
+    }
+    operands.emplace_back( std::move(term) );
+  }
+  return operands;
 }
 
-// Define built-in functions
-template <>
-inline void Handle<double>::initialize() {
-  add(
-    std::string("if_then_else"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.size() != 3) throw std::runtime_error("LIMEX: if_then_else() requires exactly two arguments");
-      return args[0] ? args[1] : args[2];
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::variable(const std::string& name) {
+  return Term(nullptr, Type::variable, Operands{ getIndex(variables, name) });
+}
 
-  add(
-    std::string("n_ary_if"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.empty() || args.size()%2 != 1) throw std::runtime_error("LIMEX: n_ary_if() requires an unconditional argument");
-      for ( size_t i = 0; i < args.size()/2; i++ ) {
-        if ( args[2*i] ) return args[2*i+1];
-      }
-      return args.back();
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::collection(const std::string& name) {
+  return Term(nullptr, Type::collection, Operands{ getIndex(collections, name) });
+}
 
-  add(
-    std::string("abs"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.size() != 1) throw std::runtime_error("LIMEX: abs() requires exactly one argument");
-      return args[0] >= 0 ? args[0] : -args[0];
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::string(const std::string& value) const {
+  Term term(nullptr, (double)handle.intern(value));
+  term.quoted = true;
+  return term;
+}
 
-  add(
-    std::string("pow"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.size() != 2) throw std::runtime_error("LIMEX: pow() requires exactly two arguments");
-      return std::pow(args[0],args[1]);
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::set(std::vector<Term> elements) const {
+  auto operands = toOperands(elements);
+  bool quoted = Term::pack(operands);
+  Term term(nullptr, Type::set, std::move(operands));
+  term.quoted = quoted;
+  return term;
+}
 
-  add(
-    std::string("sqrt"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.size() != 1) throw std::runtime_error("LIMEX: sqrt() requires exactly one argument");
-      return std::sqrt(args[0]);
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::unary(Type type, Term operand) const {
+  if ( type != Type::negate && type != Type::logical_not && type != Type::square && type != Type::cube ) {
+    throw std::logic_error("LIMEX: Illegal type '" + std::string(typeName[(int)type]) + "' for unary operator");
+  }
+  std::vector<Term> operands;
+  operands.push_back(std::move(operand));
+  return Term(nullptr, type, toOperands(operands));
+}
 
-  add(
-    std::string("cbrt"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.size() != 1) throw std::runtime_error("LIMEX: cbrt() requires exactly one argument");
-      return std::cbrt(args[0]);
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::binary(Type type, Term left, Term right) const {
+  if ( (int)type < (int)Type::logical_and || (int)type > (int)Type::not_element_of || type == Type::square || type == Type::cube ) {
+    throw std::logic_error("LIMEX: Illegal type '" + std::string(typeName[(int)type]) + "' for binary operator");
+  }
+  if ( left.type == Type::collection || right.type == Type::collection ) {
+    throw std::logic_error("LIMEX: Collections can only be used as argument of callables");
+  }
+  if ( left.type == Type::set || ( type == Type::element_of || type == Type::not_element_of ) != ( right.type == Type::set ) ) {
+    throw std::logic_error("LIMEX: Sets can only be used as right operand of '∈' and '∉'");
+  }
+  return Term(nullptr, type, Operands{ std::move(left), std::move(right) });
+}
 
-  add(
-    std::string("sum"), 
-    [](const std::vector<double>& args) -> double
-    {
-      double result = 0.0;
-      for ( double value : args ) {
-        result += value;
-      }
-      return result;
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::ternary(Term condition, Term thenTerm, Term elseTerm) const {
+  std::vector<Term> operands;
+  operands.push_back(std::move(condition));
+  operands.push_back(std::move(thenTerm));
+  operands.push_back(std::move(elseTerm));
+  return Term(nullptr, Type::if_then_else, toOperands(operands));
+}
 
-  add(
-    std::string("avg"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.empty()) throw std::runtime_error("LIMEX: avg{} requires at least one argument");
-      double result = 0.0;
-      for ( double value : args ) {
-        result += value;
-      }
-      return result / args.size();
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::call(size_t index, std::vector<Term> arguments) const {
+  handle.validate(index, arguments.size());
+  return Term(nullptr, Type::function_call, toOperands(arguments, index));
+}
 
-  add(
-    std::string("count"), 
-    [](const std::vector<double>& args) -> double
-    {
-      return args.size();
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::aggregate(size_t index, std::vector<Term> arguments) const {
+  handle.validate(index, arguments.size());
+  return Term(nullptr, Type::aggregation, toOperands(arguments, index));
+}
 
-  add(
-    std::string("min"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.empty()) throw std::runtime_error("LIMEX: min{} requires at least one argument");
-      double result = DBL_MAX;
-      for ( double value : args ) {
-        if ( result > value ) {
-          result = value;
-        };
-      }
-      return result;
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::aggregate(size_t index, const std::string& collection) {
+  if ( index >= handle.size() ) {
+    throw std::out_of_range("LIMEX: Callable index out of range");
+  }
+  return Term(nullptr, Type::aggregation, Operands{ index, this->collection(collection) });
+}
 
-  add(
-    std::string("max"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.empty()) throw std::runtime_error("LIMEX: max{} requires at least one argument");
-      double result = -DBL_MAX;
-      for ( double value : args ) {
-        if ( result < value ) {
-          result = value;
-        };
-      }
-      return result;
-    }
-  );
+template <typename T, typename C>
+inline Node<T,C> Builder<T,C>::index(const std::string& collection, Term position) {
+  if constexpr (std::is_same_v< C, std::vector<T> > || std::is_same_v< C, Collection<T> >) {
+    std::vector<Term> operands;
+    operands.push_back(std::move(position));
+    return Term(nullptr, Type::index, toOperands(operands, getIndex(collections, collection)));
+  }
+  else if constexpr (std::is_same_v< C, T >) {
+    std::vector<Term> operands;
+    operands.push_back(this->collection(collection));
+    operands.push_back(std::move(position));
+    return Term(nullptr, Type::function_call, toOperands(operands, handle.getIndex("at")));
+  }
+  else {
+    static_assert([]{ return false; }(), "LIMEX: unexpected collection type");
+  }
+}
 
-  add(
-    std::string("element_of"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.empty()) throw std::runtime_error("LIMEX: ∈ {...} requires at least one argument");
-      for ( size_t i = 1; i < args.size(); i++ ) {
-        if (args[0] == args[i]) {
-          return true;
-        }
-      }
-      return false;
+template <typename T, typename C>
+inline void Builder<T,C>::bind(Term& term, Expression<T,C>* expression) {
+  term.expression = expression;
+  for ( auto& operand : term.operands ) {
+    if ( std::holds_alternative<Term>(operand) ) {
+      bind(std::get<Term>(operand), expression);
     }
-  );
+  }
+  term.updateAwaitable();
+}
 
-  add(
-    std::string("not_element_of"), 
-    [](const std::vector<double>& args) -> double
-    {
-      if (args.empty()) throw std::runtime_error("LIMEX: ∉ {...} requires at least one argument");
-      for ( size_t i = 1; i < args.size(); i++ ) {
-        if (args[0] == args[i]) {
-          return false;
-        }
-      }
-      return true;
-    }
-  );
+template <typename T, typename C>
+inline Expression<T,C> Builder<T,C>::build(Term root) {
+  if ( root.type == Type::set || root.type == Type::collection ) {
+    throw std::logic_error("LIMEX: Illegal root of expression");
+  }
+  // root is enclosed in a group in the same way as by the parser
+  Term group(nullptr, Type::group, Operands{ std::move(root) });
+  auto bound = [&group](Expression<T,C>* expression) {
+    bind(group, expression);
+    return std::move(group);
+  };
+  return Expression<T,C>(handle, std::exchange(variables, {}), std::exchange(collections, {}), std::nullopt, bound);
+}
 
-  add(
-    std::string("at"), 
-    [](const std::vector<double>& args [[maybe_unused]]) -> double
-    {
-      throw std::runtime_error("LIMEX: at() not relevant for handle of type double");
-    }
-  );
+template <typename T, typename C>
+inline Expression<T,C> Builder<T,C>::build(const std::string& target, Type type, Term value) {
+  if ( (int)type < (int)Type::assign ) {
+    throw std::logic_error("LIMEX: Illegal type '" + std::string(typeName[(int)type]) + "' for assignment");
+  }
+  if ( type == Type::assign ) {
+    // target of a definition is not a variable of the expression
+    Term definition(nullptr, Type::group, Operands{ Term(nullptr, type, Operands{ std::move(value) }) });
+    auto bound = [&definition](Expression<T,C>* expression) {
+      bind(definition, expression);
+      return std::move(definition);
+    };
+    return Expression<T,C>(handle, std::exchange(variables, {}), std::exchange(collections, {}), target, bound);
+  }
+  Term assignment(nullptr, Type::group, Operands{ Term(nullptr, type, Operands{ variable(target), std::move(value) }) });
+  auto bound = [&assignment](Expression<T,C>* expression) {
+    bind(assignment, expression);
+    return std::move(assignment);
+  };
+  return Expression<T,C>(handle, std::exchange(variables, {}), std::exchange(collections, {}), target, bound);
 }
 
 } // namespace LIMEX
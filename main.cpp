@@ -4,6 +4,8 @@
 
 #include "limex.h"
 
+#include "generator.h"
+#include "conformance.h"
 #include "test.h"
 
 
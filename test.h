@@ -1,6 +1,8 @@
 #include <cassert>
 #include <iostream>
 #include <map>
+#include <atomic>
+#include <thread>
 
 constexpr const char* RESET_COLOR = "\033[0m";
 constexpr const char* GREEN_COLOR = "\033[32m";
@@ -80,6 +82,1037 @@ void test( std::string input, std::map<std::string,double> valueMap, std::map<st
   }
 }
 
+void testError( std::string input ) {
+  LIMEX::Handle<double> handle;
+  try {
+    LIMEX::Expression<double> expression(input,handle);
+    std::cerr << input << " = " << expression.evaluate();
+    std::cerr << RED_COLOR << " [fail, expected error]" << RESET_COLOR << std::endl;
+  }
+  catch (const std::exception& e) {
+    std::cerr << input << " raises '" << e.what() << "'";
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testOverlay() {
+  LIMEX::Handle<double> base;
+  base.add("twice", [](const std::vector<double>& args) { return 2 * args.at(0); });
+  LIMEX::Handle<double> tenant = base; // shares overlay with base
+  tenant.add("thrice", [](const std::vector<double>& args) { return 3 * args.at(0); });
+  try {
+    LIMEX::Expression<double> expression("twice(2) + thrice(2)",tenant);
+    std::cerr << "overlay with twice(2) + thrice(2) = " << expression.evaluate();
+    bool separated = false;
+    try {
+      base.getIndex("thrice");
+    }
+    catch (const std::exception& e) {
+      separated = true;
+    }
+    if ( expression.evaluate() == 10 && separated && base.getIndex("sum") == tenant.getIndex("sum") ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, overlays not separated]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating overlay" << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testRegistry( size_t readers, size_t versions ) {
+  LIMEX::Handle<double> handle;
+  LIMEX::Registry<double> registry(handle);
+  registry.publish({ {"price", "x * 1"}, {"tax", "x / 10"} });
+  std::atomic<bool> done = false;
+  std::atomic<size_t> errors = 0;
+  std::vector<std::thread> threads;
+  for ( size_t i = 0; i < readers; i++ ) {
+    threads.emplace_back([&]() {
+      while ( !done ) {
+        auto rules = registry.acquire();
+        // rule 'price' of version v multiplies by v
+        if ( rules->at("price").evaluate({2.0}) != 2.0 * rules->getVersion() ) {
+          errors++;
+        }
+      }
+    });
+  }
+  for ( size_t version = 2; version <= versions; version++ ) {
+    registry.publish({ {"price", "x * " + std::to_string(version)}, {"tax", "x / 10"} });
+  }
+  done = true;
+  for ( auto& thread : threads ) {
+    thread.join();
+  }
+  std::cerr << versions << " versions published while evaluating with " << readers << " readers";
+  if ( errors == 0 && registry.acquire()->getVersion() == versions ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail, " << errors << " inconsistent evaluations]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testLazy( std::string input, std::map<std::string,double> valueMap, std::map<std::string,std::vector<double>> collectionMap = {} ) {
+  LIMEX::Handle<double> handle;
+  try {
+    LIMEX::Expression<double> eager(input,handle);
+    LIMEX::Expression<double> lazy(input,handle,LIMEX::Expression<double>::PARSING::LAZY);
+    bool sameNames = ( 
+      eager.getVariables() == lazy.getVariables() && 
+      eager.getCollections() == lazy.getCollections() && 
+      eager.getTarget() == lazy.getTarget() 
+    );
+    std::vector<double> variableValues;
+    for ( auto variable : lazy.getVariables() ) {
+      variableValues.push_back( valueMap.at(variable) );
+    }
+    std::vector< std::vector<double> > collectionValues;
+    for ( auto collection : lazy.getCollections() ) {
+      collectionValues.push_back( collectionMap.at(collection) );
+    }
+    std::cerr << "lazily parsed " << input << " = " << lazy.evaluate(variableValues,collectionValues);
+    // moved expressions keep working whether or not the tree has been built
+    LIMEX::Expression<double> unbuilt(input,handle,LIMEX::Expression<double>::PARSING::LAZY);
+    LIMEX::Expression<double> moved(std::move(unbuilt));
+    LIMEX::Expression<double> rebound(std::move(eager));
+    if ( sameNames && lazy.evaluate(variableValues,collectionValues) == rebound.evaluate(variableValues,collectionValues) && moved.evaluate(variableValues,collectionValues) == rebound.evaluate(variableValues,collectionValues) && lazy.getVariables() == rebound.getVariables() ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, differs from eager parsing]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating: " + input << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testArchive( std::vector<std::string> inputs, std::vector<double> variableValues, std::vector< std::vector<double> > collectionValues ) {
+  LIMEX::Handle<double> handle;
+  try {
+    // budget suffices for a single inflated expression
+    LIMEX::Archive<double> archive(handle, 1);
+    std::vector<double> expected;
+    for ( auto& input : inputs ) {
+      LIMEX::Expression<double> expression(input,handle);
+      expected.push_back( expression.evaluate(variableValues,collectionValues) );
+      archive.add(expression);
+    }
+    bool correct = true;
+    for ( size_t round = 0; round < 2; round++ ) {
+      for ( size_t id = 0; id < inputs.size(); id++ ) {
+        auto expression = archive.get(id);
+        correct = correct && ( expression->evaluate(variableValues,collectionValues) == expected[id] );
+        correct = correct && ( archive.get(id) == expression ); // served from cache
+      }
+    }
+    auto statistics = archive.getStatistics();
+    std::cerr << inputs.size() << " archived expressions in " << statistics.encodedBytes << " bytes with " << statistics.evictions << " evictions";
+    if ( correct && statistics.misses == 2 * inputs.size() && statistics.hits == 2 * inputs.size() && statistics.evictions == 2 * inputs.size() - 1 ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, unexpected evaluation or statistics]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed archiving expressions" << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testCanonical( std::string lhs, std::string rhs, bool equivalent, std::map<std::string,double> valueMap = {} ) {
+  LIMEX::Handle<double> handle;
+  try {
+    LIMEX::Expression<double> left(lhs,handle), right(rhs,handle);
+    auto evaluate = [&valueMap](const LIMEX::Expression<double>& expression) {
+      std::vector<double> variableValues;
+      for ( auto variable : expression.getVariables() ) {
+        variableValues.push_back( valueMap.at(variable) );
+      }
+      return expression.evaluate(variableValues);
+    };
+    double before = evaluate(left);
+    left.canonicalize();
+    right.canonicalize();
+    std::cerr << lhs << ( equivalent ? " equivalent to " : " different from " ) << rhs;
+    if ( ( left.hash128() == right.hash128() ) == equivalent && evaluate(left) == before && ( !equivalent || left.stringify() == right.stringify() ) ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, " << left.stringify() << " vs " << right.stringify() << "]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed canonicalizing: " + lhs + " and " + rhs << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testBatch( std::string input, std::map<std::string,std::vector<double>> columnMap, std::map<std::string,std::vector<double>> collectionMap = {} ) {
+  LIMEX::Handle<double> handle;
+  try {
+    LIMEX::Expression<double> expression(input,handle);
+    std::vector< std::vector<double> > variableColumns;
+    for ( auto variable : expression.getVariables() ) {
+      variableColumns.push_back( columnMap.at(variable) );
+    }
+    std::vector< std::vector<double> > collectionValues;
+    for ( auto collection : expression.getCollections() ) {
+      collectionValues.push_back( collectionMap.at(collection) );
+    }
+    size_t rows = variableColumns.empty() ? 1 : variableColumns.front().size();
+    std::vector<double> expected;
+    for ( size_t row = 0; row < rows; row++ ) {
+      std::vector<double> variableValues;
+      for ( auto& column : variableColumns ) {
+        variableValues.push_back( column[row] );
+      }
+      expected.push_back( expression.evaluate(variableValues,collectionValues) );
+    }
+    LIMEX::Pool pool(3);
+    auto results = std::make_unique_for_overwrite<double[]>(rows);
+    expression.evaluateBatch(pool, std::span<double>(results.get(), rows), variableColumns, collectionValues);
+    std::cerr << "batch of " << rows << " rows for " << input;
+    if ( expression.evaluateBatch(variableColumns,collectionValues) == expected && std::equal(expected.begin(), expected.end(), results.get()) ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, batch differs from row-wise evaluation]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating: " + input << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testColumns( std::string input, std::vector<std::vector<double>> variableColumns ) {
+  LIMEX::Handle<double> handle;
+  size_t scalarCalls = 0, columnCalls = 0;
+  handle.add(
+    "lerp",
+    [&scalarCalls](const std::vector<double>& args) -> double {
+      scalarCalls++;
+      return args.at(0) + args.at(2) * (args.at(1) - args.at(0));
+    },
+    [&columnCalls](const std::vector< std::span<const double> >& args, std::span<double> results) {
+      columnCalls++;
+      for ( size_t row = 0; row < results.size(); row++ ) {
+        results[row] = args.at(0)[row] + args.at(2)[row] * (args.at(1)[row] - args.at(0)[row]);
+      }
+    }
+  );
+  try {
+    LIMEX::Expression<double> expression(input,handle);
+    auto results = expression.evaluateBatch(variableColumns);
+    bool correct = ( scalarCalls == 0 && columnCalls == 1 );
+    for ( size_t row = 0; row < results.size(); row++ ) {
+      std::vector<double> variableValues;
+      for ( auto& column : variableColumns ) {
+        variableValues.push_back( column[row] );
+      }
+      correct = correct && ( results[row] == expression.evaluate(variableValues) );
+    }
+    std::cerr << "column-wise callable in " << input;
+    if ( correct ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, expected a single column-wise call]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating: " + input << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testSharedPool() {
+  LIMEX::Handle<double> handle;
+  LIMEX::Expression<double> expression("3*x + 1",handle);
+  LIMEX::Pool pool(2);
+  std::atomic<size_t> wrong = 0;
+  auto evaluate = [&] {
+    for ( size_t i = 0; i < 50; i++ ) {
+      std::vector<double> results(100);
+      expression.evaluateBatch(pool, results, { std::vector<double>(100, double(i)) });
+      if ( results.front() != 3 * double(i) + 1 || results.back() != 3 * double(i) + 1 ) {
+        wrong++;
+      }
+    }
+  };
+  std::thread first(evaluate), second(evaluate);
+  first.join();
+  second.join();
+  bool rejected = false;
+  try {
+    pool.run([&pool](size_t) { pool.run([](size_t) {}); });
+  }
+  catch (const std::logic_error&) {
+    rejected = true;
+  }
+  std::cerr << "shared pool";
+  if ( wrong == 0 && rejected ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail, concurrent runs interfered or nested run accepted]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testAsync( std::string input, std::vector<std::vector<double>> rows, size_t expectedBulkCalls ) {
+  LIMEX::Handle<double> handle;
+  size_t requests = 0;
+  handle.addAwaitable("rate", [&requests](const std::vector< std::vector<double> >& calls) {
+    std::vector<double> results;
+    for ( auto& arguments : calls ) {
+      results.push_back( 10 * arguments.at(0) );
+    }
+    requests += calls.size();
+    return results;
+  });
+  try {
+    LIMEX::Expression<double> expression(input,handle);
+    LIMEX::Scheduler<double> scheduler;
+    for ( auto& row : rows ) {
+      scheduler.submit(expression, row);
+    }
+    scheduler.run();
+    bool correct = ( scheduler.getBulkCalls() == expectedBulkCalls );
+    for ( size_t i = 0; i < rows.size(); i++ ) {
+      correct = correct && ( scheduler.get(i) == expression.evaluate(rows[i]) );
+    }
+    std::cerr << rows.size() << " asynchronous evaluations of " << input << " with " << scheduler.getBulkCalls() << " bulk calls";
+    if ( correct ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, expected " << expectedBulkCalls << " bulk calls]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating: " + input << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testAsyncHandles() {
+  // callables of the same name and index in two handles
+  std::vector< LIMEX::Handle<double> > handles(2);
+  for ( size_t i = 0; i < handles.size(); i++ ) {
+    double factor = ( i == 0 ) ? 10 : 100;
+    handles[i].addAwaitable("rate", [factor](const std::vector< std::vector<double> >& calls) {
+      std::vector<double> results;
+      for ( auto& arguments : calls ) {
+        results.push_back( factor * arguments.at(0) );
+      }
+      return results;
+    });
+  }
+  LIMEX::Expression<double> first("rate(x)",handles[0]);
+  LIMEX::Expression<double> second("rate(x)",handles[1]);
+  LIMEX::Scheduler<double> scheduler;
+  scheduler.submit(first, {2.0});
+  scheduler.submit(second, {2.0});
+  scheduler.run();
+  std::cerr << "Asynchronous evaluations with two handles = " << scheduler.get(0) << ", " << scheduler.get(1);
+  if ( scheduler.get(0) == 20 && scheduler.get(1) == 200 && scheduler.getBulkCalls() == 2 ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail, expected 20, 200]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testCache( std::string input, std::vector< std::vector<double> > rows, std::map<std::string,std::vector<double>> collectionMap = {} ) {
+  LIMEX::Handle<double> handle;
+  handle.add("noise", [](const std::vector<double>& args) { return args.empty() ? 0.0 : args[0]; });
+  try {
+    LIMEX::Expression<double> cached(input,handle);
+    LIMEX::Expression<double> uncached(input,handle);
+    cached.enableCache(64);
+    std::vector< std::vector<double> > collectionValues;
+    for ( auto collection : cached.getCollections() ) {
+      collectionValues.push_back( collectionMap.at(collection) );
+    }
+    bool same = true;
+    for ( size_t repetition = 0; repetition < 2; repetition++ ) {
+      for ( auto& row : rows ) {
+        same = same && cached.evaluate(row,collectionValues) == uncached.evaluate(row,collectionValues);
+      }
+    }
+    auto statistics = cached.getCacheStatistics();
+    // collections modified in place must not give results cached for the previous contents
+    for ( auto& collection : collectionValues ) {
+      for ( auto& value : collection ) {
+        value += 1.0;
+      }
+    }
+    for ( auto& row : rows ) {
+      same = same && cached.evaluate(row,collectionValues) == uncached.evaluate(row,collectionValues);
+    }
+    std::cerr << "cached " << input << " with hit ratio " << statistics.getHitRatio();
+    if ( same && statistics.hits == rows.size() && statistics.misses == rows.size() ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, expected " << rows.size() << " hits and misses]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating: " + input << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testCacheBypass() {
+  LIMEX::Handle<double> handle;
+  LIMEX::Expression<double> expression("x + sum{y[]}",handle);
+  expression.enableCache(64, 2);
+  std::vector<double> small = { 1.0, 2.0 }, large = { 1.0, 2.0, 3.0 };
+  bool correct = true;
+  for ( size_t repetition = 0; repetition < 2; repetition++ ) {
+    correct = correct && expression.evaluate({1.0}, {small}) == 4.0 && expression.evaluate({1.0}, {large}) == 7.0;
+  }
+  auto statistics = expression.getCacheStatistics();
+  std::cerr << "cache bypassed for " << statistics.bypasses << " evaluations with large collections";
+  if ( correct && statistics.hits == 1 && statistics.misses == 1 && statistics.bypasses == 2 ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail, expected 1 hit, 1 miss, and 2 bypasses]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testImpureCache( std::string input ) {
+  LIMEX::Handle<double> handle;
+  handle.add("noise", [](const std::vector<double>& args) { return args.empty() ? 0.0 : args[0]; });
+  LIMEX::Expression<double> expression(input,handle);
+  try {
+    expression.enableCache(64);
+    std::cerr << "cached impure " << input << RED_COLOR << " [fail, expected error]" << RESET_COLOR << std::endl;
+  }
+  catch (const std::logic_error& e) {
+    std::cerr << "refused caching " << input << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testSpecialization( std::string input, std::vector< std::vector<double> > rows, size_t observations, std::vector<std::string> constants, std::map<std::string,std::vector<double>> collectionMap = {}, std::optional< std::vector<double> > partialRow = std::nullopt ) {
+  LIMEX::Handle<double> handle;
+  try {
+    LIMEX::Expression<double> specialized(input,handle);
+    LIMEX::Expression<double> general(input,handle);
+    specialized.enableSpecialization(observations);
+    std::vector< std::vector<double> > collectionValues;
+    for ( auto collection : specialized.getCollections() ) {
+      collectionValues.push_back( collectionMap.at(collection) );
+    }
+    bool same = true;
+    for ( auto& row : rows ) {
+      same = same && specialized.evaluate(row,collectionValues) == general.evaluate(row,collectionValues);
+    }
+    auto statistics = specialized.getSpecializationStatistics();
+    if ( partialRow.has_value() ) {
+      // missing values must be reported by the specialized as by the general version
+      auto raises = [&](const LIMEX::Expression<double>& expression) {
+        try {
+          expression.evaluate(partialRow.value(),collectionValues);
+          return false;
+        }
+        catch (const std::runtime_error&) {
+          return true;
+        }
+      };
+      same = same && raises(specialized) && raises(general);
+    }
+    std::cerr << "specialized " << input << " with " << statistics.hits << " hits and " << statistics.failures << " guard failures";
+    if ( same && statistics.constants == constants && statistics.hits + statistics.failures == ( constants.empty() ? 0 : rows.size() - observations ) ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, differs from general evaluation]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating: " + input << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testBuilder( std::string input, std::function<LIMEX::Expression<double>(LIMEX::Builder<double>&)> build, std::map<std::string,double> valueMap, std::map<std::string,std::vector<double>> collectionMap = {} ) {
+  LIMEX::Handle<double> handle;
+  try {
+    LIMEX::Builder<double> builder(handle);
+    LIMEX::Expression<double> built = build(builder);
+    LIMEX::Expression<double> parsed(input,handle);
+    auto evaluate = [&](const LIMEX::Expression<double>& expression) {
+      std::vector<double> variableValues;
+      for ( auto variable : expression.getVariables() ) {
+        variableValues.push_back( valueMap.at(variable) );
+      }
+      std::vector< std::vector<double> > collectionValues;
+      for ( auto collection : expression.getCollections() ) {
+        collectionValues.push_back( collectionMap.at(collection) );
+      }
+      return expression.evaluate(variableValues,collectionValues);
+    };
+    std::cerr << "built " << input << " = " << evaluate(built);
+    // roots of built and parsed trees are groups
+    if ( evaluate(built) == evaluate(parsed) && built.getTarget() == parsed.getTarget() && built.getRoot().type == parsed.getRoot().type ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, differs from parsed expression]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating: " + input << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testBuilderError( std::string input, std::function<void(LIMEX::Builder<double>&)> build ) {
+  LIMEX::Handle<double> handle;
+  LIMEX::Builder<double> builder(handle);
+  try {
+    build(builder);
+    std::cerr << "built " << input << RED_COLOR << " [fail, expected error]" << RESET_COLOR << std::endl;
+  }
+  catch (const std::exception& e) {
+    std::cerr << "building " << input << " raises '" << e.what() << "'";
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testRetarget( std::string input, std::vector<double> variableValues, std::vector< std::vector<double> > collectionValues = {} ) {
+  LIMEX::Handle<double> source;
+  source.add("f", [](const std::vector<double>& args) { return args[0] + 1; });
+  LIMEX::Handle<double> handle;
+  handle.add("g", [](const std::vector<double>& args) { return args[0] - 1; });
+  handle.add("f", [](const std::vector<double>& args) { return args[0] + 1; });
+  try {
+    LIMEX::Expression<double> original(input,source);
+    LIMEX::Expression<double> retargeted(original,handle);
+    std::cerr << "retargeted " << input << " = " << retargeted.evaluate(variableValues,collectionValues);
+    if ( retargeted.evaluate(variableValues,collectionValues) == original.evaluate(variableValues,collectionValues) && retargeted.stringify() == original.stringify() ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, differs from original]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating: " + input << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testSerialize( std::string input, std::map<std::string,double> valueMap, std::map<std::string,std::vector<double>> collectionMap = {}, bool canonical = true ) {
+  LIMEX::Handle<double> handle;
+  try {
+    LIMEX::Expression<double> original(input,handle);
+    if ( canonical ) {
+      original.canonicalize();
+    }
+    auto evaluate = [&](const LIMEX::Expression<double>& expression) {
+      std::vector<double> variableValues;
+      for ( auto variable : expression.getVariables() ) {
+        variableValues.push_back( valueMap.at(variable) );
+      }
+      std::vector< std::vector<double> > collectionValues;
+      for ( auto collection : expression.getCollections() ) {
+        collectionValues.push_back( collectionMap.at(collection) );
+      }
+      return expression.evaluate(variableValues,collectionValues);
+    };
+    std::string serialized = original.serialize();
+    LIMEX::Expression<double> reparsed(serialized,handle);
+    if ( canonical ) {
+      reparsed.canonicalize();
+    }
+    std::cerr << input << " serialized as " << serialized;
+    if ( evaluate(reparsed) == evaluate(original) && reparsed.serialize() == serialized && reparsed.getTarget() == original.getTarget() ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, differs from original]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating: " + input << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testLiterals( size_t size ) {
+  LIMEX::Handle<double> handle;
+  std::string elements;
+  for ( size_t i = 1; i <= size; i++ ) {
+    elements += ( i > 1 ? ", " : "" ) + std::to_string(i) + ".25";
+  }
+  try {
+    LIMEX::Expression<double> contained("x ∈ {" + elements + "}",handle);
+    LIMEX::Expression<double> excluded("(x ∉ {" + elements + ", y}) ? 2 : 3",handle);
+    std::cerr << "set of " << size << " literals";
+    if ( contained.evaluate({ size - 0.75 }) == 1.0 && contained.evaluate({ 0.25 }) == 0.0 && excluded.evaluate({ 0.25, 0.5 }) == 2.0 ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, wrong membership]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed evaluating set of " << size << " literals" << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testGenerator( uint64_t seed, std::vector<std::string> expected ) {
+  // expressions must not depend on the implementation of the standard library
+  Generator generator(Generator::Shape{ .depth = 2 }, seed);
+  std::vector<std::string> generated;
+  for ( size_t i = 0; i < expected.size(); i++ ) {
+    generated.push_back( generator.expression() );
+  }
+  std::cerr << "generated " << generated.size() << " expressions for seed " << seed;
+  if ( generated == expected ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail, first expression " << generated.front() << "]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testGenerator( Generator::Shape shape, size_t count ) {
+  // expressions of shapes without names must not refer to variables or collections
+  LIMEX::Handle<double> handle;
+  Generator generator(shape, 1);
+  size_t named = 0;
+  try {
+    for ( size_t i = 0; i < count; i++ ) {
+      LIMEX::Expression<double> expression(generator.expression(),handle);
+      named += expression.getVariables().size() + expression.getCollections().size();
+    }
+    std::cerr << "generated " << count << " expressions with " << shape.variables << " variables and " << shape.collections << " collections";
+    if ( named == 0 || ( shape.variables && shape.collections ) ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, " << named << " names generated]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Failed generating expressions" << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void testConformance( uint64_t seed, size_t count ) {
+  LIMEX::Handle<double> handle;
+  Conformance conformance(handle);
+  Generator generator(Generator::Shape{}, seed);
+  size_t checks = 0;
+  std::vector<Conformance::Mismatch> mismatches;
+  for ( size_t i = 0; i < count; i++ ) {
+    auto input = generator.expression();
+    Conformance::Variables variables;
+    auto values = generator.variableValues(4);
+    for ( size_t j = 0; j < values.size(); j++ ) {
+      variables["x" + std::to_string(j + 1)] = values[j];
+    }
+    auto collectionValues = generator.collectionValues(2);
+    Conformance::Collections collections = { {"c1", collectionValues[0]}, {"c2", collectionValues[1]} };
+    // all collections, collections with illegal indices, and a missing collection
+    Conformance::Collections truncated = { {"c1", { collectionValues[0].begin(), collectionValues[0].begin() + 4 }}, {"c2", {}} };
+    Conformance::Collections missing = { {"c1", collectionValues[0]} };
+    for ( auto& values : { collections, truncated, missing } ) {
+      auto found = conformance.check(input, variables, values);
+      mismatches.insert(mismatches.end(), found.begin(), found.end());
+      checks++;
+    }
+  }
+  std::cerr << checks << " conformance checks of " << conformance.getEngines().size() << " engines for seed " << seed;
+  if ( mismatches.empty() ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail, " << mismatches.size() << " mismatches]" << RESET_COLOR << std::endl;
+    for ( auto& mismatch : mismatches ) {
+      std::cerr << "  " << mismatch.engine << ": " << mismatch.reproducer << " gives " << Conformance::describe(mismatch.actual) << " instead of " << Conformance::describe(mismatch.expected) << std::endl;
+    }
+  }
+}
+
+void testMinimization( std::string input, std::map<std::string,double> valueMap, std::string expected ) {
+  LIMEX::Handle<double> handle;
+  Conformance conformance(handle, false);
+  // faulty engine giving wrong results for divisions
+  conformance.add({ "faulty", 0, [](auto& handle, auto& input, auto& variables, auto& collections) {
+    LIMEX::Expression<double> expression(input,handle);
+    auto [variableValues, collectionValues] = Conformance::arguments(expression,variables,collections);
+    return expression.evaluate(variableValues,collectionValues) + ( input.find('/') != std::string::npos );
+  }});
+  auto mismatches = conformance.check(input, valueMap);
+  std::string reproducer = mismatches.empty() ? "" : mismatches.front().reproducer;
+  std::cerr << "Mismatch of " << input << " reduced to " << reproducer;
+  if ( mismatches.size() == 1 && reproducer == expected ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail, expected " << expected << "]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testSampler( std::string input, std::vector<double> variableValues, std::vector< std::vector<double> > collectionValues, size_t evaluations, size_t operations ) {
+  LIMEX::Handle<double> handle;
+  bool correct = true;
+  try {
+    LIMEX::Expression<double> expression(input,handle);
+    // all evaluations exceed the threshold
+    auto sampler = std::make_shared< LIMEX::Sampler<double> >(std::chrono::nanoseconds(0), 4, 3);
+    expression.sample(sampler);
+    for ( size_t i = 0; i < evaluations; i++ ) {
+      expression.evaluate(variableValues,collectionValues);
+    }
+    auto samples = sampler->dump();
+    correct = ( samples.size() == std::min<size_t>(evaluations, 4) && sampler->dump().empty() );
+    for ( auto& sample : samples ) {
+      correct = correct && sample.input == input && sample.variables.size() == variableValues.size() && sample.collections.size() == collectionValues.size();
+      for ( size_t i = 0; correct && i < sample.variables.size(); i++ ) {
+        correct = sample.variables[i].first == expression.getVariables()[i] && sample.variables[i].second == variableValues[i];
+      }
+      for ( size_t i = 0; correct && i < sample.collections.size(); i++ ) {
+        correct = sample.collections[i].second == collectionValues[i].size();
+      }
+      correct = correct && !sample.timings.empty() && sample.timings.size() <= 3;
+      for ( size_t i = 1; correct && i < sample.timings.size(); i++ ) {
+        correct = sample.timings[i - 1].duration >= sample.timings[i].duration;
+      }
+    }
+    // the breakdown descends along the hot path regardless of the duration of the evaluation
+    sampler->record(expression, std::chrono::nanoseconds(1), variableValues, collectionValues);
+    auto fast = sampler->dump();
+    correct = correct && fast.size() == 1 && fast.front().timings.size() == std::min<size_t>(operations, 3);
+    correct = correct && std::ranges::any_of(fast.front().timings, [](auto& timing) { return timing.depth == 1; });
+    // expressions without input are recorded in infix notation
+    LIMEX::Builder<double> builder(handle);
+    auto built = builder.build( builder.binary(LIMEX::Type::add, builder.variable("x"), builder.literal(1)) );
+    sampler->record(built, std::chrono::nanoseconds(1), {2.0}, {});
+    auto described = sampler->dump();
+    correct = correct && described.size() == 1 && described.front().input == "x + 1";
+    std::cerr << samples.size() << " samples of " << input;
+    if ( !samples.empty() ) {
+      std::cerr << " with slowest subexpression " << samples.back().timings.front().subexpression;
+    }
+    // no evaluation exceeds the threshold
+    expression.sample(std::make_shared< LIMEX::Sampler<double> >(std::chrono::hours(1)));
+    expression.evaluate(variableValues,collectionValues);
+  }
+  catch (const std::exception& e) {
+    std::cerr << input << " raises '" << e.what() << "'";
+    correct = false;
+  }
+  if ( correct ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testProvidedBudget() {
+  // stop is requested while the elements of a provided collection without span are fetched
+  LIMEX::Handle<double, LIMEX::Collection<double>> handle;
+  std::stop_source source;
+  size_t fetched = 0;
+  LIMEX::Collection<double> large( LIMEX::Collection<double>::Provider{ 
+    .element = [&](double index) -> std::optional<double> { 
+      if ( ++fetched == 10 ) {
+        source.request_stop();
+      }
+      return index; 
+    }, 
+    .size = 1000000 
+  });
+  bool raised = false;
+  try {
+    LIMEX::Expression<double, LIMEX::Collection<double>> expression("sum{a[]}",handle);
+    LIMEX::Budget budget(source.get_token(), 16);
+    expression.evaluate({}, { large });
+  }
+  catch (const LIMEX::Cancelled&) {
+    raised = true;
+  }
+  std::cerr << "aggregation of provided collection cancelled after fetching " << fetched << " elements";
+  if ( raised && fetched <= 32 ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail, expected cancellation while fetching]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testBudget( std::string input, std::function<double(LIMEX::Expression<double>&)> evaluate, std::function<std::unique_ptr<LIMEX::Budget>()> budget, bool cancelled ) {
+  LIMEX::Handle<double> handle;
+  handle.add("wait", [](const std::vector<double>& args) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return args[0];
+  });
+  std::string label = input.size() > 40 ? input.substr(0, 40) + "..." : input;
+  bool raised = false;
+  auto start = std::chrono::steady_clock::now();
+  try {
+    LIMEX::Expression<double> expression(input,handle);
+    start = std::chrono::steady_clock::now();
+    auto scope = budget();
+    evaluate(expression);
+  }
+  catch (const LIMEX::Cancelled& e) {
+    std::cerr << label << " raises '" << e.what() << "'";
+    raised = true;
+  }
+  catch (const std::exception& e) {
+    std::cerr << label << " raises '" << e.what() << "'" << RED_COLOR << " [fail]" << RESET_COLOR << std::endl;
+    return;
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  if ( !raised ) {
+    std::cerr << label << " is not cancelled";
+  }
+  // no budget must remain installed and cancelled evaluations must be aborted early
+  if ( raised == cancelled && !LIMEX::Budget::getCurrent() && elapsed < std::chrono::milliseconds(250) ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail, expected " << ( cancelled ? "cancellation" : "no cancellation" ) << "]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testCost( std::string input, std::string symbolic, std::vector<size_t> sizes, double estimate ) {
+  LIMEX::Handle<double> handle;
+  LIMEX::Descriptor<double> descriptor;
+  descriptor.cost = 50;
+  handle.add("lookup", [](const std::vector<double>& args) { return args[0]; }, descriptor);
+  try {
+    LIMEX::Expression<double> expression(input,handle);
+    auto cost = expression.estimateCost();
+    std::cerr << "Cost of " << input << " is " << cost.stringify() << " = " << cost.estimate(sizes);
+    if ( cost.stringify() == symbolic && cost.estimate(sizes) == estimate ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, expected " << symbolic << " = " << estimate << "]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << input << " raises '" << e.what() << "'" << RED_COLOR << " [fail]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testStrings( std::string input, std::map<std::string,std::string> valueMap, double result ) {
+  LIMEX::Handle<double> handle;
+  try {
+    LIMEX::Expression<double> expression(input,handle);
+    // strings of another expression and strings not in the dictionary
+    LIMEX::Expression<double> other("(segment == \"B\") || (segment == \"A\")",handle);
+    std::vector<double> variableValues;
+    for ( auto variable : expression.getVariables() ) {
+      std::cerr << variable << " = \"" << valueMap.at(variable) << "\" ";
+      variableValues.push_back( handle.encode(valueMap.at(variable)) );
+    }
+    auto value = expression.evaluate(variableValues);
+    // strings are written as strings and are encoded again by other handles with other codes
+    LIMEX::Handle<double> second;
+    second.intern("C");
+    LIMEX::Expression<double> reparsed(expression.serialize(),second);
+    LIMEX::Expression<double> retargeted(expression,second);
+    LIMEX::Archive<double> archive(handle, 1);
+    auto archived = archive.get( archive.add(expression) );
+    std::vector<double> secondValues;
+    for ( auto variable : reparsed.getVariables() ) {
+      secondValues.push_back( second.encode(valueMap.at(variable)) );
+    }
+    bool encoded = ( 
+      reparsed.evaluate(secondValues) == result && retargeted.evaluate(secondValues) == result && 
+      archived->serialize() == expression.serialize() && reparsed.hash() == expression.hash() 
+    );
+    std::cerr << "implies " << input << " = " << value;
+    if ( value == result && encoded && handle.getString(handle.intern("A")) == "A" && handle.getCode("unknown") == 0 ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, expected " << result << "]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << input << " raises '" << e.what() << "'" << RED_COLOR << " [fail]" << RESET_COLOR << std::endl;
+  }
+}
+
+void testKeyed( std::string input, std::map<std::string,double> valueMap, std::optional<double> result ) {
+  LIMEX::Handle<double, LIMEX::Collection<double>> handle;
+  // sparse collection with large keys and dense collection
+  std::map<std::string, LIMEX::Collection<double>> collectionMap = {
+    { "rates", LIMEX::Collection<double>({ 1000000007, 42, -5 }, { 2.5, 3.0, 7.0 }) },
+    { "c", { 1.0, 2.0, 3.0 } }
+  };
+  try {
+    LIMEX::Expression<double, LIMEX::Collection<double>> expression(input,handle);
+    std::vector<double> variableValues;
+    std::vector< std::vector<double> > variableColumns;
+    for ( auto variable : expression.getVariables() ) {
+      std::cerr << variable << " = " << valueMap.at(variable) << " ";
+      variableValues.push_back( valueMap.at(variable) );
+      variableColumns.push_back( std::vector<double>(20, valueMap.at(variable)) );
+    }
+    std::vector< LIMEX::Collection<double> > collectionValues;
+    for ( auto collection : expression.getCollections() ) {
+      collectionValues.push_back( collectionMap.at(collection) );
+    }
+    auto value = expression.evaluate(variableValues,collectionValues);
+    std::cerr << "implies " << input << " = " << value;
+    auto results = expression.evaluateBatch(variableColumns,collectionValues);
+    if ( result.has_value() && value == result.value() && std::ranges::all_of(results, [&](double row) { return row == value; }) ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, expected " << ( result.has_value() ? std::to_string(result.value()) : "error" ) << "]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "raises '" << e.what() << "'";
+    if ( !result.has_value() ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail]" << RESET_COLOR << std::endl;
+    }
+  }
+}
+
+void testProvider( std::string input, std::map<std::string,double> valueMap, std::optional<double> result, size_t fetches, std::string access ) {
+  LIMEX::Handle<double, LIMEX::Collection<double>> handle;
+  size_t fetched = 0;
+  // large collection of which only accessed elements are fetched
+  LIMEX::Collection<double> large( LIMEX::Collection<double>::Provider{ 
+    .element = [&](double index) -> std::optional<double> { 
+      fetched++;
+      return index >= 1 && index <= 1000000 ? std::optional<double>(2 * index) : std::nullopt; 
+    }, 
+    .size = 1000000 
+  });
+  // collection providing a span of all values, which is requested at most once per aggregation
+  std::vector<double> values = { 1.0, 2.0, 3.0, 4.0 };
+  size_t spans = 0;
+  LIMEX::Collection<double> small( LIMEX::Collection<double>::Provider{ 
+    .element = [&](double index) -> std::optional<double> { 
+      fetched++;
+      return index >= 1 && index <= 4 ? std::optional<double>(values[(size_t)index - 1]) : std::nullopt; 
+    },
+    .span = [&]() { spans++; return std::span<const double>(values); }
+  });
+  // collection of unknown size
+  LIMEX::Collection<double> unknown( LIMEX::Collection<double>::Provider{ .element = [](double index) { return std::optional<double>(index); } });
+  std::map<std::string, LIMEX::Collection<double>> collectionMap = { { "a", large }, { "b", small }, { "c", unknown } };
+  try {
+    LIMEX::Expression<double, LIMEX::Collection<double>> expression(input,handle);
+    std::string analysis;
+    auto collectionAccess = expression.getCollectionAccess();
+    for ( size_t i = 0; i < collectionAccess.size(); i++ ) {
+      analysis += ( i ? ", " : "" ) + expression.getCollections()[i] + "=" + std::to_string(collectionAccess[i].points) + ( collectionAccess[i].scanned ? "+scan" : "" );
+    }
+    std::vector<double> variableValues;
+    for ( auto variable : expression.getVariables() ) {
+      variableValues.push_back( valueMap.at(variable) );
+    }
+    std::vector< LIMEX::Collection<double> > collectionValues;
+    for ( auto collection : expression.getCollections() ) {
+      collectionValues.push_back( collectionMap.at(collection) );
+    }
+    std::cerr << input << " with access " << analysis;
+    std::optional<double> value;
+    try {
+      value = expression.evaluate(variableValues,collectionValues);
+      std::cerr << " = " << value.value() << " fetching " << fetched << " elements";
+    }
+    catch (const std::exception& e) {
+      std::cerr << " raises '" << e.what() << "'";
+    }
+    if ( value == result && fetched == fetches && analysis == access && spans <= 1 ) {
+      std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+    }
+    else {
+      std::cerr << RED_COLOR << " [fail, expected access " << access << "]" << RESET_COLOR << std::endl;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << input << " raises '" << e.what() << "'" << RED_COLOR << " [fail]" << RESET_COLOR << std::endl;
+  }
+}
+
+#ifdef LIMEX_METRICS
+void testMetrics() {
+  using LIMEX::Metrics;
+  LIMEX::Handle<double> handle;
+  // a single expression is tracked
+  Metrics::enable(4, 1);
+  Metrics::reset();
+  std::string input = "x / y + sum{x, y, 1} + count{c[]}";
+  bool correct = true;
+  try {
+    LIMEX::Expression<double> expression(input,handle);
+    for ( size_t i = 0; i < 8; i++ ) {
+      expression.evaluate({1.0, 2.0}, { {1.0, 2.0, 3.0} });
+    }
+    try {
+      expression.evaluate({1.0, 0.0}, { {1.0, 2.0, 3.0} });
+      correct = false;
+    }
+    catch ( const std::runtime_error& ) {}
+    try {
+      LIMEX::Expression<double> invalid("1.2.3 + x",handle);
+      correct = false;
+    }
+    catch ( const std::runtime_error& ) {}
+    expression.evaluateBatch({ {1.0, 2.0}, {3.0, 4.0} }, { {1.0, 2.0, 3.0} });
+    LIMEX::Expression<double> other("x + 1",handle);
+    for ( size_t i = 0; i < 4; i++ ) {
+      other.evaluate({1.0});
+    }
+  }
+  catch (const std::exception& e) {
+    correct = false;
+  }
+  auto snapshot = Metrics::snapshot();
+  Metrics::disable();
+  // evaluations 1, 5, 9, and 13 are sampled, the third one fails and the last one is not tracked
+  correct = correct && snapshot.parses == 2 && snapshot.evaluations == 13 && snapshot.batches == 1 && snapshot.rows == 2;
+  correct = correct && snapshot.errors[(size_t)Metrics::Category::DIVISION_BY_ZERO] == 1 && snapshot.errors[(size_t)Metrics::Category::PARSING] == 1;
+  correct = correct && snapshot.evaluationDuration.getCount() == 3 && snapshot.expressions.size() == 1;
+  correct = correct && snapshot.expressions.begin()->second.expression == input && snapshot.expressions.begin()->second.duration.getCount() == 2;
+  correct = correct && snapshot.aggregationSize.getCount() >= 16 && snapshot.aggregationSize.getPercentile(100) == 3;
+  for ( uint64_t value : { 0ull, 7ull, 8ull, 15ull, 16ull, 1000ull, 123456789ull, ~0ull } ) {
+    // buckets have a relative width of at most 1/8
+    auto upper = Metrics::Histogram::upper( Metrics::Histogram::bucket(value) );
+    correct = correct && upper >= value && upper - value <= value / 8;
+  }
+  std::cerr << "Metrics of " << snapshot.parses << " parses, " << snapshot.evaluations << " evaluations, and " << snapshot.rows << " rows";
+  if ( correct ) {
+    std::cerr << GREEN_COLOR << " [pass]" << RESET_COLOR << std::endl;
+  }
+  else {
+    std::cerr << RED_COLOR << " [fail]" << RESET_COLOR << std::endl;
+  }
+}
+#endif
+
 void test() {
 // Literals
   test("3*5", 3*5); // multiply
@@ -190,4 +1223,183 @@ void test() {
   test("x /= 3 > 2", { {"x", 5.0} }, 5);
   test("x /= if x > 3 then 2 else 1", { {"x", 5.0} }, 2.5);
   test("x /= if x > 3 then 2 else 1", { {"x", 2.0} }, 2);
+
+// Errors
+  testError("abs(1, 2)"); // too many arguments
+  testError("pow(2)"); // too few arguments
+  testError("sqrt(4, 9)"); // too many arguments
+  testError("x + 1"); // missing variable value
+
+// Handles
+  testOverlay();
+  testRegistry(4, 50);
+
+// Lazy parsing
+  testLazy("z - y[x] + sum{y[]} * x", { {"x", 2.0}, {"z", 1.0} }, { {"y", {4.0, 5.0}} });
+  testLazy("x := if y > 3 then count{z[]} else w", { {"y", 5.0}, {"w", 1.0} }, { {"z", {4.0, 5.0}} });
+  testLazy("x := x + 1", { {"x", 2.0} });
+  testLazy("x -= y ? a : b", { {"x", 2.0}, {"y", 0.0}, {"a", 1.0}, {"b", 3.0} });
+
+// Canonical forms
+  testCanonical("b + a", "a+b", true, { {"a", 1.0}, {"b", 2.0} });
+  testCanonical("x ≤ 3", "x <= 3", true, { {"x", 1.0} });
+  testCanonical("max{x, y}", "max{y, x}", true, { {"x", 1.0}, {"y", 2.0} });
+  testCanonical("sum{x, y, z}", "sum{z, y, x}", false, { {"x", 1e16}, {"y", 1.0}, {"z", -1e16} }); // order of summation affects rounding
+  testCanonical("((a)) * (b)", "b*a", true, { {"a", 1.0}, {"b", 2.0} });
+  testCanonical("3 > x", "x < 3", true, { {"x", 1.0} });
+  testCanonical("-2 * x", "x * -2.0", true, { {"x", 1.0} });
+  testCanonical("x ∈ {3, y, 1}", "x in {y, 1, 3}", true, { {"x", 1.0}, {"y", 2.0} });
+  testCanonical("a - b", "b - a", false, { {"a", 1.0}, {"b", 2.0} });
+  testCanonical("pow(a, b)", "pow(b, a)", false, { {"a", 1.0}, {"b", 2.0} });
+  testCanonical("x := a", "y := a", false, { {"a", 1.0} });
+  testCanonical("pow(-0, -1)", "pow(0, -1)", false);
+
+// Archives
+  testArchive( { "x * 1.5 + y[2]", "sum{y[]} / -x", "(x ∈ {1, 2, 300000}) ? pow(x, 0.5) : x²", "z := if x > 1 then 2 else 3" }, { 2.0 }, { { 1.0, 2.0, 3.0 } } );
+
+// Batches
+  testBatch("3*x + y", { {"x", {1.0, 2.0, 3.0, 4.0, 5.0}}, {"y", {5.0, 4.0, 3.0, 2.0, 1.0}} });
+  testBatch("x > 2 ? x² : -x", { {"x", {1.0, 2.0, 3.0, 4.0}} });
+  testBatch("y + x[z]", { {"y", {1.0, 2.0}}, {"z", {1.0, 3.0}} }, { {"x", { 2.0, 5.0, 3.0} } });
+  testBatch("sum{x, y, 2}", { {"x", {1.0, 2.0, 3.0}}, {"y", {5.0, 4.0, 3.0}} });
+  testBatch("(x ∈ {1, y}) ? pow(x, 2) : max{x, y}", { {"x", {1.0, 2.0, 3.0}}, {"y", {3.0, 2.0, 1.0}} });
+  testColumns("2 * lerp(x, y, 0.25)", { {0.0, 1.0, 2.0}, {4.0, 5.0, 6.0} });
+  testSharedPool();
+
+// Asynchronous evaluation
+  testAsync("x + rate(y)", { {1.0, 2.0}, {3.0, 4.0}, {5.0, 6.0} }, 1);
+  testAsync("rate(rate(x)) - rate(2) * x", { {1.0}, {3.0} }, 3);
+  testAsync("x > 2 ? rate(x)² : sum{x, rate(x)}", { {1.0}, {3.0} }, 2);
+  testAsyncHandles();
+
+// Result caches
+  testCache("3*x + y", { {1.0, 2.0}, {2.0, 3.0}, {-0.0, 1.0} });
+  testCache("pow(x, -1) + y", { {-0.0, 1.0}, {0.0, 1.0} });
+  testCache("(x ∈ {1, 2}) ? sum{y[]} : y[x]", { {1.0}, {3.0} }, { {"y", {4.0, 5.0, 6.0}} });
+  testCacheBypass();
+  testImpureCache("x + noise(x)");
+
+// Speculative specialization
+  testSpecialization("(c ∈ {1, 2}) ? x * pow(c, 2) : -x", { {1.0, 2.0}, {1.0, 3.0}, {1.0, 4.0}, {1.0, 5.0}, {3.0, 5.0} }, 2, { "c" });
+  testSpecialization("if c == 0 then y[c + 1] else sum{y[]} + x", { {0.0, 2.0}, {0.0, 3.0}, {0.0, 4.0}, {-0.0, 4.0} }, 2, { "c" }, { {"y", {4.0, 5.0}} });
+  testSpecialization("x + y", { {1.0, 2.0}, {2.0, 3.0}, {3.0, 4.0} }, 2, {});
+  testSpecialization("if y > 0 then y else c", { {1.0, 5.0}, {2.0, 5.0}, {3.0, 5.0} }, 2, { "c" }, {}, std::vector<double>{ 4.0 });
+
+// Builder
+  testBuilder("3*x + sqrt(y[2])", [](auto& builder) {
+    return builder.build(
+      builder.binary(LIMEX::Type::add, 
+        builder.binary(LIMEX::Type::multiply, builder.literal(3), builder.variable("x")),
+        builder.call("sqrt", { builder.index("y", builder.literal(2)) })
+      )
+    );
+  }, { {"x", 2.0} }, { {"y", {1.0, 16.0}} });
+  testBuilder("z += (x ∈ {1, 2}) ? sum{y[]} : -x²", [](auto& builder) {
+    auto condition = builder.binary(LIMEX::Type::element_of, builder.variable("x"), builder.set({ builder.literal(1), builder.literal(2) }));
+    auto negation = builder.unary(LIMEX::Type::negate, builder.unary(LIMEX::Type::square, builder.variable("x")));
+    return builder.build("z", LIMEX::Type::add_assign, builder.ternary(std::move(condition), builder.aggregate("sum", "y"), std::move(negation)));
+  }, { {"x", 2.0}, {"z", 1.0} }, { {"y", {1.0, 16.0}} });
+  testBuilder("z := max{x, 4}", [](auto& builder) {
+    return builder.build("z", LIMEX::Type::assign, builder.aggregate("max", { builder.variable("x"), builder.literal(4) }));
+  }, { {"x", 2.0} });
+  testBuilderError("pow(x)", [](auto& builder) { builder.call("pow", { builder.variable("x") }); });
+  testBuilderError("{x} + 1", [](auto& builder) { builder.binary(LIMEX::Type::add, builder.set({ builder.variable("x") }), builder.literal(1)); });
+  testBuilderError("x + inf serialized", [](auto& builder) { builder.build(builder.binary(LIMEX::Type::add, builder.variable("x"), builder.literal(std::numeric_limits<double>::infinity()))).serialize(); });
+
+// Retargeting
+  testRetarget("f(x) * sum{y[]}", { 2.0 }, { { 1.0, 2.0 } });
+  testRetarget("z := (x ∈ {1, 2}) ? f(f(y[2])) : max{x, f(1)}", { 3.0 }, { { 1.0, 2.0 } });
+
+// Serialization
+  testSerialize("-x^2 + -(x^2) - (-2)² * -x", { {"x", 3.0} });
+  testSerialize("(a - b) - (c - d) / (a * (b / c))", { {"a", 1.0}, {"b", 2.0}, {"c", 4.0}, {"d", 8.0} });
+  testSerialize("2^(3^2) + (2^3)^2 + 2^3^2", {});
+  testSerialize("(c ? a : b) + 1 - (a + (c ? a : b)) + (a + b ? c : d) + (c ? a : b < d)", { {"a", 1.0}, {"b", 2.0}, {"c", 0.0}, {"d", 3.0} });
+  testSerialize("((x < 3) ? x : -x) + (x ≥ 1 ? 1 : 0) * 0.1", { {"x", 2.0} });
+  testSerialize("z := (x ∈ {1, 2}) ? sum{y[]} : !(x == 3 || x == 4) && y[2]", { {"x", 2.0} }, { {"y", {1.0, 2.0}} });
+  testSerialize("z := (a - b) - (c ? a : b)", { {"a", 1.0}, {"b", 2.0}, {"c", 0.0} }, {}, false);
+  testSerialize("c ? (a ? b : c) : (b ? c : a)", { {"a", 1.0}, {"b", 2.0}, {"c", 0.0} }, {}, false);
+  testSerialize("z *= -2 * pow(x, 0.001 * 0 + 0.000001) / 12345678901234567890", { {"x", 2.0}, {"z", 1.0} });
+  testSerialize(std::string("x") + [] { std::string sum; for ( size_t i = 0; i < 200; i++ ) sum += " + x"; return sum; }(), { {"x", 0.5} });
+
+// Literal-heavy expressions
+  testLiterals(20000);
+  testSerialize("x ∈ {3, 1.5, y, 0.25}", { {"x", 0.25}, {"y", 2.0} });
+  testCanonical("x ∈ {3, 1.5, y}", "x ∈ {y, 3, 1.5}", true, { {"x", 1.5}, {"y", 2.0} });
+  testError("1.2.3 + x");
+
+// Differential conformance
+  testGenerator(42, { "∛((6.25) + (x4))", "cbrt(∑{c2[]})", "((c1[5]) - (x4)) <= ((x3)^3)" });
+  testGenerator(Generator::Shape{ .variables = 0, .collections = 0 }, 200);
+  testConformance(1, 200);
+  testConformance(2, 200);
+  testMinimization("(x + y * 2) / (abs(z) + 1) - sum{x, y}", { {"x", 1.0}, {"y", 2.0}, {"z", 3.0} }, "0 / 1");
+
+// String literals
+  testStrings("country == \"DE\"", { {"country", "DE"} }, 1);
+  testStrings("country == \"DE\"", { {"country", "FR"} }, 0);
+  testStrings("segment ∈ {\"A\", \"B\"}", { {"segment", "B"} }, 1);
+  testStrings("segment ∉ {\"A\", \"B\"}", { {"segment", "C"} }, 1);
+  testStrings("((country == \"DE\") && (segment != \"A\")) ? 2 : 3", { {"country", "DE"}, {"segment", "B"} }, 2);
+  testStrings("name == \"say \\\"hi\\\"\"", { {"name", "say \"hi\""} }, 1);
+  testStrings("country == origin", { {"country", "XX"}, {"origin", "YY"} }, 0); // unknown strings differ
+  testStrings("(segment ∈ {\"A\", other}) == (\"B\" == segment)", { {"segment", "B"}, {"other", "B"} }, 1);
+  testError("\"B\" + \"A\""); // strings are only compared
+  testError("\"A\" < \"B\"");
+  testError("abs(\"A\")");
+  testError("\"A\"");
+  testError("1 ∈ {\"A\", 1}"); // codes and numbers in the same set
+  testError("country == \"DE");
+
+// Keyed collections
+  testKeyed("rates[id] * x", { {"id", 1000000007}, {"x", 2} }, 5);
+  testKeyed("rates[-5] + c[i]", { {"i", 2} }, 9);
+  testKeyed("sum{rates[]} + count{c[]}", {}, 15.5);
+  testKeyed("rates[id]", { {"id", 43} }, std::nullopt);
+  testKeyed("rates[id]", { {"id", 42.5} }, std::nullopt);
+  testKeyed("c[4]", {}, std::nullopt);
+
+// Provided collections
+  testProvider("a[i] + b[j]", { {"i", 500000}, {"j", 2} }, 1000002, 2, "a=1, b=1");
+  testProvider("sum{b[]} + a[3] + a[i]", { {"i", 1} }, 18, 2, "b=0+scan, a=2");
+  testProvider("count{c[]}", {}, std::nullopt, 0, "c=0+scan");
+  testProvider("a[i]", { {"i", 0} }, std::nullopt, 1, "a=1");
+
+// Cost estimation
+  testCost("3*x + y/2", "6", {}, 6);
+  testCost("sum{c[]} * x + c[3] - max{d[]}", "4 + 1·|c| + 1·|d|", {10, 5}, 19);
+  testCost("sqrt(x) + pow(x, 2) + (x ∈ {1, 2, 3})", "35", {}, 35);
+  testCost("if x > 0 then c[x] else lookup(x)", "53", {100}, 53);
+
+// Runtime metrics
+#ifdef LIMEX_METRICS
+  testMetrics();
+#endif
+
+// Slow evaluations
+  testSampler("x * sum{c[]} + (y ∈ {1, 2, 3, 4, 5, 6, 7, 8})", {2.0, 5.0}, { {1.0, 2.0, 3.0} }, 6, 4);
+  testSampler("x + 1", {2.0}, {}, 2, 1);
+
+// Cancellation and time budgets
+  auto expired = [] { return std::make_unique<LIMEX::Budget>(LIMEX::Budget::Clock::now()); };
+  auto sum = [](auto& expression) { return expression.evaluate({}, { std::vector<double>(1000000, 1.0) }); };
+  testBudget("sum{c[]}", sum, expired, true);
+  testBudget("sum{c[]}", sum, [] { return std::make_unique<LIMEX::Budget>(std::chrono::hours(1)); }, false);
+  testBudget("x + 1", [](auto& expression) { return expression.evaluate({1.0}); }, [] {
+    std::stop_source source;
+    source.request_stop();
+    return std::make_unique<LIMEX::Budget>(source.get_token());
+  }, true);
+  std::string waits = "wait(0)";
+  for ( size_t i = 1; i < 500; i++ ) {
+    waits += " + wait(" + std::to_string(i % 10) + ")";
+  }
+  testBudget(waits, [](auto& expression) { return expression.evaluate(); }, [] { return std::make_unique<LIMEX::Budget>(std::chrono::milliseconds(20), std::stop_token(), 16); }, true);
+  testBudget("3 * x", [](auto& expression) {
+    LIMEX::Pool pool(2);
+    std::vector<double> results(1000);
+    expression.evaluateBatch(pool, results, { std::vector<double>(1000, 1.0) });
+    return results[0];
+  }, expired, true);
+  testProvidedBudget();
 }